@@ -0,0 +1,896 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "sources/MagicalContainer.hpp"
+#include "sources/ChunkedStorage.hpp"
+#include "sources/Primality.hpp"
+#include "sources/OrderStatisticTree.hpp"
+#include "sources/Parallel.hpp"
+#include "sources/RadixSort.hpp"
+#include "sources/RunLengthStorage.hpp"
+
+using namespace ariel;
+using namespace std;
+
+namespace
+{
+    // Every operator new in this binary, so benchmarks can report allocations
+    atomic<size_t> allocations(0);
+}
+
+void *operator new(size_t size)
+{
+    allocations.fetch_add(1, memory_order_relaxed);
+    if (void *memory = malloc(size == 0 ? 1 : size))
+    {
+        return memory;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void *memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept
+{
+    free(memory);
+}
+
+namespace
+{
+    // Run 'body' once and return the elapsed wall time in milliseconds
+    template <typename Body>
+    double timeMs(Body body)
+    {
+        auto start = chrono::steady_clock::now();
+        body();
+        auto stop = chrono::steady_clock::now();
+        return chrono::duration<double, milli>(stop - start).count();
+    }
+
+    // Uniformly distributed values, the same sequence on every run
+    vector<int> randomValues(size_t count, unsigned seed = 42)
+    {
+        mt19937 generator(seed);
+        uniform_int_distribution<int> distribution(0, 1000000000);
+        vector<int> values(count);
+        for (int &value : values)
+        {
+            value = distribution(generator);
+        }
+        return values;
+    }
+
+    void report(const string &label, size_t count, double ms)
+    {
+        cout << "  " << label << ": " << ms << " ms (" << count << " elements)" << endl;
+    }
+
+    // addElement in a loop against one addElements call
+    void benchBulkLoad(size_t count)
+    {
+        cout << "bulk load" << endl;
+        vector<int> values = randomValues(count);
+
+        MagicalContainer looped;
+        report("addElement loop", count, timeMs([&] {
+            for (int value : values)
+            {
+                looped.addElement(value);
+            }
+        }));
+
+        MagicalContainer bulk;
+        report("addElements", count, timeMs([&] { bulk.addElements(values); }));
+
+        if (!ranges::equal(looped.elementsView(), bulk.elementsView()))
+        {
+            cout << "  mismatch between the two containers!" << endl;
+        }
+    }
+
+    // Random inserts followed by random removals on a preloaded container
+    void benchMutations(size_t count)
+    {
+        cout << "mutations on " << count << " preloaded elements" << endl;
+        vector<int> preload = randomValues(count);
+        vector<int> values = randomValues(10000, 7);
+
+        MagicalContainer container;
+        container.addElements(preload);
+        report("flat vector insert+remove", values.size(), timeMs([&] {
+            for (int value : values)
+            {
+                container.addElement(value);
+            }
+            for (int value : values)
+            {
+                container.removeElement(value);
+            }
+        }));
+
+        MagicalContainer chunked(MagicalContainer::Storage::Chunked);
+        chunked.addElements(preload);
+        report("chunked insert+remove", values.size(), timeMs([&] {
+            for (int value : values)
+            {
+                chunked.addElement(value);
+            }
+            for (int value : values)
+            {
+                chunked.removeElement(value);
+            }
+        }));
+
+        long long sum = 0;
+        report("chunked ascending walk", static_cast<size_t>(chunked.size()), timeMs([&] {
+            for (int value : chunked.ascending())
+            {
+                sum += value;
+            }
+        }));
+        report("chunked prime walk", chunked.primes().size(), timeMs([&] {
+            MagicalContainer::PrimeIterator it(chunked);
+            for (MagicalContainer::PrimeIterator last = MagicalContainer::PrimeIterator(chunked).end(); it != last; ++it)
+            {
+                sum += *it;
+            }
+        }));
+        cout << "  (checksum " << sum << ")" << endl;
+    }
+
+    // Linear find against the binary-searched removeElement, at fixed sizes
+    void benchRemove(size_t)
+    {
+        const size_t removals = 1000;
+        for (size_t count : {size_t{10000}, size_t{1000000}, size_t{10000000}})
+        {
+            cout << "remove from " << count << " elements" << endl;
+            vector<int> preload = randomValues(count);
+            vector<int> targets(preload.begin(), preload.begin() + removals);
+
+            vector<int> linear = preload;
+            sort(linear.begin(), linear.end());
+            report("std::find + erase", removals, timeMs([&] {
+                for (int value : targets)
+                {
+                    linear.erase(find(linear.begin(), linear.end(), value));
+                }
+            }));
+
+            MagicalContainer container;
+            container.addElements(preload);
+            report("removeElement", removals, timeMs([&] {
+                for (int value : targets)
+                {
+                    container.removeElement(value);
+                }
+            }));
+        }
+    }
+
+    // Throwing removeElement against tryRemove when a share of the removals miss
+    void benchMisses(size_t count)
+    {
+        const size_t removals = min(count, size_t{100000});
+        // Even values 0, 2, 4, ... are stored, odd values always miss
+        vector<int> preload(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            preload[i] = static_cast<int>(2 * i);
+        }
+        for (int missPercent : {0, 10, 40, 90})
+        {
+            cout << "remove with " << missPercent << "% misses" << endl;
+            // Hits take the largest stored value so the erase itself stays cheap
+            vector<int> targets;
+            mt19937 generator(static_cast<unsigned>(missPercent));
+            int largest = preload.back();
+            for (size_t i = 0; i < removals; ++i)
+            {
+                bool miss = static_cast<int>(generator() % 100) < missPercent;
+                targets.push_back(miss ? largest - 1 : largest);
+                largest -= miss ? 0 : 2;
+            }
+
+            MagicalContainer throwing;
+            throwing.addElements(preload);
+            report("removeElement + catch", removals, timeMs([&] {
+                for (int value : targets)
+                {
+                    try
+                    {
+                        throwing.removeElement(value);
+                    }
+                    catch (const runtime_error &)
+                    {
+                    }
+                }
+            }));
+
+            MagicalContainer quiet;
+            quiet.addElements(preload);
+            report("tryRemove", removals, timeMs([&] {
+                for (int value : targets)
+                {
+                    quiet.tryRemove(value);
+                }
+            }));
+        }
+    }
+
+    // Trial division, the sieve and Miller-Rabin on odd values starting at several magnitudes
+    void benchPrimality(size_t count)
+    {
+        PrimeSieve sieve;
+        for (uint64_t start : {uint64_t{1001}, uint64_t{1000001}, uint64_t{1000000001}, uint64_t{1000000000000000001}})
+        {
+            cout << "primality of " << count << " odd values from " << start << endl;
+            size_t found = 0;
+            if (start < static_cast<uint64_t>(INT32_MAX) - 2 * count)
+            {
+                int first = static_cast<int>(start);
+                report("trial division", count, timeMs([&] {
+                    for (size_t i = 0; i < count; ++i)
+                    {
+                        found += isPrimeByTrialDivision(first + 2 * static_cast<int>(i)) ? 1U : 0U;
+                    }
+                }));
+            }
+            if (start + 2 * count < sieve.getBound())
+            {
+                int first = static_cast<int>(start);
+                report("sieve", count, timeMs([&] {
+                    for (size_t i = 0; i < count; ++i)
+                    {
+                        found += sieve.isPrime(first + 2 * static_cast<int>(i)) ? 1U : 0U;
+                    }
+                }));
+            }
+            report("Miller-Rabin", count, timeMs([&] {
+                for (size_t i = 0; i < count; ++i)
+                {
+                    found += isPrimeMillerRabin(start + 2 * i) ? 1U : 0U;
+                }
+            }));
+            cout << "  (" << found << " primes counted)" << endl;
+        }
+    }
+
+    // Several full prime traversals: testing each element against reading the cached flags
+    void benchPrimeTraversal(size_t count)
+    {
+        const int passes = 10;
+        cout << passes << " prime traversals over " << count << " elements" << endl;
+        MagicalContainer container;
+        container.addElements(randomValues(count));
+
+        size_t found = 0;
+        span<const int> values = container.elementsView();
+        report("isPrime per element", count, timeMs([&] {
+            for (int pass = 0; pass < passes; ++pass)
+            {
+                for (int value : values)
+                {
+                    found += isPrime(value) ? 1U : 0U;
+                }
+            }
+        }));
+        report("PrimeIterator", count, timeMs([&] {
+            for (int pass = 0; pass < passes; ++pass)
+            {
+                MagicalContainer::PrimeIterator it(container);
+                for (MagicalContainer::PrimeIterator last = MagicalContainer::PrimeIterator(container).end(); it != last; ++it)
+                {
+                    ++found;
+                }
+            }
+        }));
+        cout << "  (" << found << " primes counted)" << endl;
+    }
+
+    // One prime hidden among composites: begin(), a step and end() on the prime iterator
+    void benchSparsePrimes(size_t count)
+    {
+        cout << "one prime among " << count << " composites" << endl;
+        vector<int> values(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            values[i] = 4 + 2 * static_cast<int>(i);
+        }
+        values.back() = 2147483647;
+        MagicalContainer container;
+        container.addElements(values);
+
+        const int repeats = 100000;
+        long long found = 0;
+        MagicalContainer::PrimeIterator it(container);
+        report("begin + step + end", static_cast<size_t>(repeats), timeMs([&] {
+            for (int repeat = 0; repeat < repeats; ++repeat)
+            {
+                found += *it.begin();
+                ++it;
+                found += it == it.end() ? 1 : 0;
+            }
+        }));
+        span<const int> view = container.elementsView();
+        report("linear scan for the prime", static_cast<size_t>(repeats / 1000), timeMs([&] {
+            for (int repeat = 0; repeat < repeats / 1000; ++repeat)
+            {
+                found += *find_if(view.begin(), view.end(), [](int value) { return value % 2 != 0; });
+            }
+        }));
+        cout << "  (checksum " << found << ")" << endl;
+    }
+
+    // Exporting every prime one iterator step at a time against the batched bitset scan
+    void benchPrimeExport(size_t count)
+    {
+        cout << "export the primes of " << count << " elements" << endl;
+        MagicalContainer container;
+        container.addElements(randomValues(count));
+
+        vector<int> exported;
+        exported.reserve(count);
+        report("PrimeIterator", count, timeMs([&] {
+            MagicalContainer::PrimeIterator it(container);
+            for (MagicalContainer::PrimeIterator last = MagicalContainer::PrimeIterator(container).end(); it != last; ++it)
+            {
+                exported.push_back(*it);
+            }
+        }));
+
+        vector<int> batched;
+        batched.reserve(count);
+        vector<int> buffer(4096);
+        report("scanPrimes batches", count, timeMs([&] {
+            size_t from = 0;
+            size_t copied = 0;
+            while ((copied = container.scanPrimes(from, buffer)) > 0)
+            {
+                batched.insert(batched.end(), buffer.begin(), buffer.begin() + static_cast<ptrdiff_t>(copied));
+            }
+        }));
+        if (exported != batched)
+        {
+            cout << "  mismatch between the two exports!" << endl;
+        }
+    }
+
+    // Per-element cost of a full traversal with each iterator, over a container or a storage engine
+    template <typename Iterator, typename Container>
+    void timeTraversal(const string &label, Container &container, int passes)
+    {
+        long long sum = 0;
+        double ms = timeMs([&] {
+            for (int pass = 0; pass < passes; ++pass)
+            {
+                Iterator it(container);
+                for (Iterator last = Iterator(container).end(); it != last; ++it)
+                {
+                    sum += *it;
+                }
+            }
+        });
+        double elements = static_cast<double>(container.size()) * passes;
+        cout << "  " << label << ": " << ms * 1e6 / elements << " ns/element (checksum " << sum << ")" << endl;
+    }
+
+    template <typename View>
+    void timeView(const string &label, View view, int size, int passes)
+    {
+        long long sum = 0;
+        double ms = timeMs([&] {
+            for (int pass = 0; pass < passes; ++pass)
+            {
+                for (int value : view)
+                {
+                    sum += value;
+                }
+            }
+        });
+        double elements = static_cast<double>(size) * passes;
+        cout << "  " << label << ": " << ms * 1e6 / elements << " ns/element (checksum " << sum << ")" << endl;
+    }
+
+    void benchIterate(size_t count)
+    {
+        cout << "traversal cost over " << count << " elements" << endl;
+        MagicalContainer container;
+        container.addElements(randomValues(count));
+        const int passes = 20;
+        timeTraversal<MagicalContainer::AscendingIterator>("ascending", container, passes);
+        timeTraversal<MagicalContainer::SideCrossIterator>("side cross", container, passes);
+        timeTraversal<MagicalContainer::PrimeIterator>("prime", container, passes);
+        timeView("ascending view", container.ascending(), container.size(), passes);
+        timeView("side cross view", container.sideCross(), container.size(), passes);
+        timeView("prime view", container.primes(), container.size(), passes);
+    }
+
+    // Export one element per step against fill() into a reusable buffer
+    template <typename Iterator>
+    void timeExport(const string &label, MagicalContainer &container)
+    {
+        vector<int> stepped;
+        stepped.reserve(static_cast<size_t>(container.size()));
+        double stepMs = timeMs([&] {
+            Iterator it(container);
+            for (Iterator last = Iterator(container).end(); it != last; ++it)
+            {
+                stepped.push_back(*it);
+            }
+        });
+
+        vector<int> filled(static_cast<size_t>(container.size()));
+        double fillMs = timeMs([&] {
+            Iterator it(container);
+            size_t total = 0;
+            while (size_t copied = it.fill(span<int>(filled).subspan(total)))
+            {
+                total += copied;
+            }
+            filled.resize(total);
+        });
+        cout << "  " << label << ": step " << stepMs << " ms, fill " << fillMs << " ms"
+             << (stepped == filled ? "" : " (mismatch!)") << endl;
+    }
+
+    void benchFill(size_t count)
+    {
+        cout << "export " << count << " elements with fill()" << endl;
+        MagicalContainer container;
+        container.addElements(randomValues(count));
+        timeExport<MagicalContainer::AscendingIterator>("ascending", container);
+        timeExport<MagicalContainer::SideCrossIterator>("side cross", container);
+        timeExport<MagicalContainer::PrimeIterator>("prime", container);
+    }
+
+    // Mixed inserts, removals, rank and select queries on the vector and the tree storage
+    void benchOrderStatistics(size_t count)
+    {
+        cout << "mixed read/write on " << count << " preloaded elements" << endl;
+        vector<int> preload = randomValues(count);
+        vector<int> values = randomValues(20000, 11);
+        long long checksum = 0;
+
+        MagicalContainer container;
+        container.addElements(preload);
+        report("vector backend", values.size(), timeMs([&] {
+            for (size_t i = 0; i < values.size(); ++i)
+            {
+                switch (i % 4)
+                {
+                case 0:
+                    container.addElement(values[i]);
+                    break;
+                case 1:
+                    container.tryRemove(values[i - 1]);
+                    break;
+                case 2:
+                    checksum += static_cast<long long>(container.rank(values[i]));
+                    break;
+                default:
+                    checksum += container.select(static_cast<size_t>(values[i]) % preload.size());
+                }
+            }
+        }));
+
+        MagicalContainer tree(MagicalContainer::Storage::OrderStatistic);
+        tree.addElements(preload);
+        report("order-statistic tree", values.size(), timeMs([&] {
+            for (size_t i = 0; i < values.size(); ++i)
+            {
+                switch (i % 4)
+                {
+                case 0:
+                    tree.addElement(values[i]);
+                    break;
+                case 1:
+                    tree.tryRemove(values[i - 1]);
+                    break;
+                case 2:
+                    checksum -= static_cast<long long>(tree.rank(values[i]));
+                    break;
+                default:
+                    checksum -= tree.select(static_cast<size_t>(values[i]) % preload.size());
+                }
+            }
+        }));
+        cout << "  (checksum " << checksum << ", 0 when both agree)" << endl;
+    }
+
+    // Trial-division primality of every element, one thread against parallel_for_each on growing pools
+    void benchParallelForEach(size_t count)
+    {
+        cout << "trial division over " << count << " elements" << endl;
+        MagicalContainer container;
+        container.addElements(randomValues(count));
+
+        size_t expected = 0;
+        report("sequential", count, timeMs([&] {
+            for (int value : container.ascending())
+            {
+                expected += isPrimeByTrialDivision(value) ? 1U : 0U;
+            }
+        }));
+        size_t hardware = std::max<size_t>(thread::hardware_concurrency(), 1);
+        for (size_t workers = 1; workers <= hardware; workers *= 2)
+        {
+            ThreadPool pool(workers);
+            atomic<size_t> found(0);
+            report("parallel_for_each, " + to_string(workers) + " workers", count, timeMs([&] {
+                parallel_for_each(container.ascending(), [&](int value) {
+                    if (isPrimeByTrialDivision(value))
+                    {
+                        found.fetch_add(1, memory_order_relaxed);
+                    }
+                }, {&pool, 0});
+            }));
+            if (found != expected)
+            {
+                throw runtime_error("parallel_for_each missed elements");
+            }
+        }
+    }
+
+    // sum, count_if, transform_into and prime classification on 1 to N workers
+    void benchParallelScaling(size_t count)
+    {
+        cout << "parallel algorithms over " << count << " elements" << endl;
+        MagicalContainer container;
+        container.addElements(randomValues(count));
+        vector<long long> squares(count);
+        vector<uint8_t> flags(count);
+        long long checksum = 0;
+
+        auto runAll = [&](const string &label, const ParallelPolicy &policy) {
+            report(label + " sum", count, timeMs([&] { checksum += parallel_sum(container, policy); }));
+            report(label + " count_if", count, timeMs([&] {
+                checksum += static_cast<long long>(parallel_count_if(container, [](int value) { return value % 3 == 0; }, policy));
+            }));
+            report(label + " transform_into", count, timeMs([&] {
+                parallel_transform_into(container, span<long long>(squares), [](int value) {
+                    return static_cast<long long>(value) * value;
+                }, policy);
+            }));
+            report(label + " classify primes", count, timeMs([&] {
+                parallel_classify_primes(container.elementsView(), flags, policy);
+            }));
+            report(label + " classify cached primes", count, timeMs([&] {
+                checksum += static_cast<long long>(parallel_classify_primes(container, policy).size());
+            }));
+        };
+
+        ParallelPolicy sequential;
+        sequential.sequentialThreshold = count + 1;
+        runAll("sequential", sequential);
+        size_t hardware = std::max<size_t>(thread::hardware_concurrency(), 1);
+        for (size_t workers = 1; workers <= hardware; workers = workers < hardware ? std::min(workers * 2, hardware) : workers + 1)
+        {
+            ThreadPool pool(workers);
+            runAll(to_string(workers) + " workers", {&pool, 0});
+        }
+        cout << "  (checksum " << checksum << ")" << endl;
+    }
+
+    // Cold-start ingestion: sequential addElements against the parallel sort-merge path
+    void benchParallelIngest(size_t count)
+    {
+        cout << "ingest " << count << " elements" << endl;
+        vector<int> values = randomValues(count);
+
+        MagicalContainer sequential;
+        report("addElements", count, timeMs([&] { sequential.addElements(values); }));
+
+        size_t hardware = std::max<size_t>(thread::hardware_concurrency(), 1);
+        for (size_t workers = 1; workers <= hardware; workers = workers < hardware ? std::min(workers * 2, hardware) : workers + 1)
+        {
+            ThreadPool pool(workers);
+            MagicalContainer parallel;
+            report("parallel addElements, " + to_string(workers) + " workers", count, timeMs([&] {
+                parallel.addElements(values, ParallelPolicy{&pool, 0});
+            }));
+            if (parallel.elements != sequential.elements)
+            {
+                cout << "  mismatch between the two containers!" << endl;
+            }
+        }
+    }
+
+    // std::sort against radix sort on uniform, skewed and already sorted batches
+    void benchRadixSort(size_t count)
+    {
+        vector<int> uniform = randomValues(count);
+        // Most values are small, a few are spread over the whole int range
+        vector<int> skewed(count);
+        mt19937 generator(5);
+        exponential_distribution<double> small(0.01);
+        uniform_int_distribution<int> any(numeric_limits<int>::min(), numeric_limits<int>::max());
+        for (int &value : skewed)
+        {
+            value = generator() % 100 == 0 ? any(generator) : static_cast<int>(small(generator));
+        }
+        vector<int> sorted = uniform;
+        std::sort(sorted.begin(), sorted.end());
+
+        const pair<const char *, const vector<int> *> inputs[] = {{"uniform", &uniform}, {"skewed", &skewed}, {"sorted", &sorted}};
+        for (const auto &[name, input] : inputs)
+        {
+            cout << name << " " << count << " elements" << endl;
+            vector<int> expected = *input;
+            report("std::sort", count, timeMs([&] { std::sort(expected.begin(), expected.end()); }));
+            vector<int> radix = *input;
+            report("radixSort", count, timeMs([&] { radixSort(radix); }));
+            vector<int> chosen = *input;
+            report("sortIntegers", count, timeMs([&] { sortIntegers(chosen); }));
+            if (radix != expected || chosen != expected)
+            {
+                throw runtime_error("radix sort disagrees with std::sort");
+            }
+        }
+    }
+
+    // Reading the elements through a copy against the zero-copy view
+    void benchElementsView(size_t count)
+    {
+        const size_t calls = 100;
+        cout << calls << " reads of " << count << " elements" << endl;
+        MagicalContainer container;
+        container.addElements(randomValues(count));
+        long long checksum = 0;
+
+        auto measure = [&](const string &label, auto read) {
+            size_t before = allocations.load();
+            double ms = timeMs([&] {
+                for (size_t call = 0; call < calls; ++call)
+                {
+                    checksum += read();
+                }
+            });
+            size_t perCall = (allocations.load() - before) / calls;
+            cout << "  " << label << ": " << ms / calls << " ms and " << perCall << " allocations per call" << endl;
+        };
+        measure("getElements", [&] {
+            vector<int> copy = container.getElements();
+            return static_cast<long long>(copy.back());
+        });
+        measure("elementsView", [&] {
+            span<const int> view = container.elementsView();
+            return static_cast<long long>(view.back());
+        });
+        measure("range for sum", [&] {
+            long long sum = 0;
+            for (int value : container)
+            {
+                sum += value;
+            }
+            return sum;
+        });
+        cout << "  (checksum " << checksum << ")" << endl;
+    }
+
+    // addElement against addElement(hint) on monotone, near-monotone and random streams
+    void benchStreams(size_t count)
+    {
+        vector<int> monotone(count);
+        vector<int> nearMonotone(count);
+        mt19937 generator(9);
+        uniform_int_distribution<int> jitter(0, 200);
+        for (size_t i = 0; i < count; ++i)
+        {
+            monotone[i] = static_cast<int>(i) * 10;
+            nearMonotone[i] = static_cast<int>(i) * 10 + jitter(generator);
+        }
+        vector<int> random = randomValues(count);
+
+        const pair<const char *, const vector<int> *> streams[] = {{"monotone", &monotone}, {"near-monotone", &nearMonotone}, {"random", &random}};
+        for (const auto &[name, stream] : streams)
+        {
+            cout << name << " stream of " << count << " elements" << endl;
+            MagicalContainer plain;
+            report("addElement", count, timeMs([&] {
+                for (int value : *stream)
+                {
+                    plain.addElement(value);
+                }
+            }));
+            MagicalContainer hinted;
+            report("addElement(hint)", count, timeMs([&] {
+                size_t hint = 0;
+                for (int value : *stream)
+                {
+                    hint = hinted.addElement(hint, value) + 1;
+                }
+            }));
+            if (plain.elements != hinted.elements)
+            {
+                throw runtime_error("hinted insertion disagrees with addElement");
+            }
+        }
+    }
+
+    // Flat vector against run-length storage on values with few distinct codes
+    void benchRunLength(size_t count)
+    {
+        const int distinct = 2000;
+        const int passes = 5;
+        cout << count << " elements over " << distinct << " distinct values" << endl;
+        vector<int> values = randomValues(count);
+        for (int &value : values)
+        {
+            value %= distinct;
+        }
+
+        MagicalContainer container;
+        container.addElements(values);
+        RunLengthStorage runs;
+        for (int value : values)
+        {
+            runs.insert(value);
+        }
+        cout << "  flat vector elements: " << container.elements.capacity() * sizeof(int) << " bytes" << endl;
+        cout << "  run-length storage: " << runs.memoryBytes() << " bytes in " << runs.runCount() << " runs" << endl;
+
+        MagicalContainer runContainer(MagicalContainer::Storage::RunLength);
+        runContainer.addElements(values);
+
+        timeTraversal<MagicalContainer::AscendingIterator>("flat ascending", container, passes);
+        timeTraversal<MagicalContainer::AscendingIterator>("run-length container ascending", runContainer, passes);
+        timeTraversal<MagicalContainer::SideCrossIterator>("flat side cross", container, passes);
+        timeTraversal<MagicalContainer::SideCrossIterator>("run-length container side cross", runContainer, passes);
+        timeTraversal<MagicalContainer::PrimeIterator>("flat prime", container, passes);
+        timeTraversal<MagicalContainer::PrimeIterator>("run-length container prime", runContainer, passes);
+
+        // Adding and removing copies of values that are already stored
+        vector<int> updates = randomValues(10000, 13);
+        report("flat add + remove", updates.size(), timeMs([&] {
+            for (int value : updates)
+            {
+                container.addElement(value % distinct);
+                container.removeElement(value % distinct);
+            }
+        }));
+        report("runs add + remove", updates.size(), timeMs([&] {
+            for (int value : updates)
+            {
+                runs.insert(value % distinct);
+                runs.erase(value % distinct);
+            }
+        }));
+        report("run-length container add + remove", updates.size(), timeMs([&] {
+            for (int value : updates)
+            {
+                runContainer.addElement(value % distinct);
+                runContainer.removeElement(value % distinct);
+            }
+        }));
+    }
+
+    // Write-heavy mixes of inserts and rank/select queries with different insert buffer sizes
+    void benchInsertBuffer(size_t count)
+    {
+        cout << "write-heavy mixes on " << count << " preloaded elements" << endl;
+        vector<int> preload = randomValues(count);
+        vector<int> values = randomValues(20000, 17);
+        const size_t readEvery[] = {0, 100, 10};
+        const size_t capacities[] = {0, 64, 1024, 8192};
+        for (size_t every : readEvery)
+        {
+            cout << (every == 0 ? string("  writes only, then one traversal") : "  one read per " + to_string(every) + " ops") << endl;
+            for (size_t capacity : capacities)
+            {
+                MagicalContainer container;
+                container.addElements(preload);
+                container.setInsertBuffer(capacity);
+                long long checksum = 0;
+                double ms = timeMs([&] {
+                    for (size_t i = 0; i < values.size(); ++i)
+                    {
+                        if (every != 0 && i % every == 0)
+                        {
+                            // Both count the buffer in place, neither merges it
+                            checksum += static_cast<long long>(container.rank(values[i]));
+                            checksum += container.select(i % preload.size());
+                        }
+                        else
+                        {
+                            container.addElement(values[i]);
+                        }
+                    }
+                    container.flush();
+                    for (int value : container.ascending())
+                    {
+                        checksum += value;
+                    }
+                });
+                report("  buffer " + to_string(capacity), values.size(), ms);
+            }
+        }
+    }
+
+    // A retention sweep: remove a fifth of the elements, eagerly and with tombstones
+    void benchTombstones(size_t count)
+    {
+        cout << "removing " << count / 5 << " of " << count << " elements" << endl;
+        vector<int> values = randomValues(count);
+        vector<int> victims(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(count / 5));
+        const double thresholds[] = {0, 0.1, 0.5, 1};
+        for (double threshold : thresholds)
+        {
+            MagicalContainer container;
+            container.addElements(values);
+            container.setTombstoneThreshold(threshold);
+            long long checksum = 0;
+            string label = threshold == 0 ? string("eager erase") : "tombstones, threshold " + to_string(threshold).substr(0, 4);
+            report(label, victims.size(), timeMs([&] {
+                for (int value : victims)
+                {
+                    container.removeElement(value);
+                }
+                MagicalContainer::AscendingIterator it(container);
+                for (MagicalContainer::AscendingIterator last = MagicalContainer::AscendingIterator(container).end(); it != last; ++it)
+                {
+                    checksum += *it;
+                }
+            }));
+            MagicalContainer::CompactionStats stats = container.compactionStats();
+            cout << "    dead ratio " << container.deadRatio() << ", " << stats.compactions << " compactions, "
+                 << stats.totalMs << " ms compacting (checksum " << checksum << ")" << endl;
+        }
+    }
+
+    struct Benchmark
+    {
+        const char *name;
+        void (*run)(size_t count);
+    };
+
+    const Benchmark benchmarks[] = {
+        {"bulk", benchBulkLoad},
+        {"mutations", benchMutations},
+        {"remove", benchRemove},
+        {"misses", benchMisses},
+        {"primality", benchPrimality},
+        {"primes", benchPrimeTraversal},
+        {"sparse", benchSparsePrimes},
+        {"export", benchPrimeExport},
+        {"iterate", benchIterate},
+        {"fill", benchFill},
+        {"ost", benchOrderStatistics},
+        {"parallel", benchParallelForEach},
+        {"scaling", benchParallelScaling},
+        {"ingest", benchParallelIngest},
+        {"radix", benchRadixSort},
+        {"view", benchElementsView},
+        {"streams", benchStreams},
+        {"runs", benchRunLength},
+        {"lsm", benchInsertBuffer},
+        {"tombstones", benchTombstones},
+    };
+}
+
+// Usage: ./bench [name|all] [element count]
+int main(int argc, char **argv)
+{
+    string selected = argc > 1 ? argv[1] : "all";
+    size_t count = argc > 2 ? strtoul(argv[2], nullptr, 10) : 50000;
+
+    for (const Benchmark &benchmark : benchmarks)
+    {
+        if (selected == "all" || selected == benchmark.name)
+        {
+            benchmark.run(count);
+        }
+    }
+    return 0;
+}
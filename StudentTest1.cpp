@@ -1,6 +1,20 @@
 #include "doctest.h"
 #include "sources/MagicalContainer.hpp"
+#include "sources/ChunkedStorage.hpp"
+#include "sources/Primality.hpp"
+#include "sources/BitVector.hpp"
+#include "sources/OrderStatisticTree.hpp"
+#include "sources/Parallel.hpp"
+#include "sources/WorkStealingDeque.hpp"
+#include "sources/RadixSort.hpp"
+#include "sources/RunLengthStorage.hpp"
+#include <random>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <ranges>
 #include <stdexcept>
+#include <limits>
 
 using namespace ariel;
 using namespace std;
@@ -594,3 +608,1347 @@ TEST_CASE("operator= throws when iterators are pointing at different containers"
     }
 }
 
+
+TEST_CASE("Bulk loading with addElements") {
+    MagicalContainer container;
+    container.addElement(5);
+    container.addElement(1);
+
+    SUBCASE("Batch is merged in ascending order") {
+        vector<int> batch = {14, 2, 4, 5, -3};
+        CHECK(container.addElements(batch.begin(), batch.end()));
+        CHECK(container.size() == 7);
+        CHECK(container.getElements() == vector<int>{-3, 1, 2, 4, 5, 5, 14});
+    }
+
+    SUBCASE("Span overload and iterators see the merged elements") {
+        int batch[] = {14, 2, 4};
+        container.addElements(span<const int>(batch));
+
+        MagicalContainer::AscendingIterator ascIt(container);
+        CHECK(*ascIt == 1);
+        MagicalContainer::SideCrossIterator crossIt(container);
+        ++crossIt;
+        CHECK(*crossIt == 14);
+        MagicalContainer::PrimeIterator primeIt(container);
+        CHECK(*primeIt == 2);
+        ++primeIt;
+        CHECK(*primeIt == 5);
+    }
+
+    SUBCASE("Empty batch leaves the container unchanged") {
+        container.addElements(span<const int>());
+        CHECK(container.getElements() == vector<int>{1, 5});
+    }
+}
+
+TEST_CASE("ChunkedStorage") {
+    // A tiny block size forces splits and merges on a handful of elements
+    ChunkedStorage storage(2);
+    for (int value : {14, 5, 1, 4, 2, 9, 3, 2}) {
+        storage.insert(value);
+    }
+
+    SUBCASE("Elements stay sorted across blocks") {
+        CHECK(storage.size() == 8);
+        CHECK(storage.blockCount() > 1);
+        CHECK(storage.toVector() == vector<int>{1, 2, 2, 3, 4, 5, 9, 14});
+    }
+
+    SUBCASE("Erasing elements") {
+        CHECK(storage.erase(2));
+        CHECK(storage.erase(14));
+        CHECK_FALSE(storage.erase(100));
+        CHECK(storage.contains(2));
+        CHECK_FALSE(storage.contains(14));
+        CHECK(storage.toVector() == vector<int>{1, 2, 3, 4, 5, 9});
+    }
+
+    SUBCASE("Container iterators walk every order across blocks") {
+        // Enough elements for several blocks of the container's chunked storage
+        MagicalContainer chunked(MagicalContainer::Storage::Chunked);
+        for (int value = 1300; value > 0; --value) {
+            chunked.addElement(value);
+        }
+        int expected = 1;
+        MagicalContainer::AscendingIterator ascIt(chunked);
+        for (; ascIt != MagicalContainer::AscendingIterator(chunked).end(); ++ascIt) {
+            CHECK(*ascIt == expected++);
+        }
+        CHECK(expected == 1301);
+        CHECK_THROWS_AS(++ascIt, runtime_error);
+
+        vector<int> cross;
+        for (MagicalContainer::SideCrossIterator crossIt(chunked); crossIt != MagicalContainer::SideCrossIterator(chunked).end(); ++crossIt) {
+            cross.push_back(*crossIt);
+        }
+        REQUIRE(cross.size() == 1300);
+        CHECK(cross[0] == 1);
+        CHECK(cross[1] == 1300);
+        CHECK(cross[2] == 2);
+        CHECK(cross[1299] == 651);
+
+        vector<int> primes;
+        for (MagicalContainer::PrimeIterator primeIt(chunked); primeIt != MagicalContainer::PrimeIterator(chunked).end(); ++primeIt) {
+            primes.push_back(*primeIt);
+        }
+        CHECK(primes.size() == 211);
+        CHECK(primes.front() == 2);
+        CHECK(primes.back() == 1297);
+    }
+
+    SUBCASE("Order statistics read the cached prime flags") {
+        SeekHint hint;
+        CHECK(storage.primeCount() == 4);
+        CHECK(storage.selectPrime(3, hint) == 5);
+        CHECK(storage.selectPrime(0, hint) == 2);
+        CHECK(storage.selectPrime(1, hint) == 2);
+        CHECK(storage.rank(4) == 4);
+        CHECK(storage.count(2) == 2);
+        CHECK(storage.select(7, hint) == 14);
+        CHECK(storage.select(6, hint) == 9);
+        CHECK_THROWS_AS(storage.select(8, hint), out_of_range);
+        CHECK(storage.eraseAll(2) == 2);
+        CHECK(storage.primeCount() == 2);
+        SeekHint fresh;
+        CHECK(storage.selectPrime(1, fresh) == 5);
+    }
+
+    SUBCASE("Empty storage") {
+        ChunkedStorage empty;
+        CHECK(empty.size() == 0);
+        CHECK(empty.toVector().empty());
+        MagicalContainer chunked(MagicalContainer::Storage::Chunked);
+        MagicalContainer::AscendingIterator ascIt(chunked);
+        CHECK(ascIt == MagicalContainer::AscendingIterator(chunked).end());
+        MagicalContainer::SideCrossIterator crossIt(chunked);
+        CHECK(crossIt == MagicalContainer::SideCrossIterator(chunked).end());
+        CHECK_THROWS_AS(*crossIt, runtime_error);
+    }
+}
+
+TEST_CASE("Container storage backends") {
+    // Every storage must behave like the vector storage on the same operations
+    mt19937 generator(42);
+    uniform_int_distribution<int> distribution(-50, 2000);
+    vector<int> values(3000);
+    for (int &value : values) {
+        value = distribution(generator);
+    }
+
+    for (MagicalContainer::Storage storage : {MagicalContainer::Storage::Chunked, MagicalContainer::Storage::OrderStatistic,
+                                              MagicalContainer::Storage::RunLength}) {
+        CAPTURE(static_cast<int>(storage));
+        MagicalContainer reference;
+        MagicalContainer container(storage);
+        CHECK(container.storage() == storage);
+        reference.addElements(values);
+        for (int value : values) {
+            container.addElement(value);
+        }
+
+        auto walk = [](auto it) {
+            vector<int> visited;
+            for (auto last = it.end(), first = it.begin(); first != last; ++first) {
+                visited.push_back(*first);
+            }
+            return visited;
+        };
+        auto sameOrders = [&] {
+            CHECK(container.size() == reference.size());
+            CHECK(container.getElements() == reference.getElements());
+            CHECK(walk(MagicalContainer::AscendingIterator(container)) == walk(MagicalContainer::AscendingIterator(reference)));
+            CHECK(walk(MagicalContainer::SideCrossIterator(container)) == walk(MagicalContainer::SideCrossIterator(reference)));
+            CHECK(walk(MagicalContainer::PrimeIterator(container)) == walk(MagicalContainer::PrimeIterator(reference)));
+            CHECK(ranges::equal(container.sideCross(), reference.sideCross()));
+            CHECK(ranges::equal(container.primes(), reference.primes()));
+        };
+        sameOrders();
+
+        // Removing values from the middle, including every copy of one
+        size_t mismatches = 0;
+        for (size_t index = 0; index < values.size(); index += 3) {
+            if (container.tryRemove(values[index]) != reference.tryRemove(values[index])) {
+                ++mismatches;
+            }
+        }
+        CHECK(mismatches == 0);
+        CHECK(container.removeAll(values[1]) == reference.removeAll(values[1]));
+        CHECK_FALSE(container.tryRemove(5000));
+        CHECK_FALSE(container.tryRemoveAll(5000).has_value());
+        sameOrders();
+
+        // Order statistics, random access and batched reads
+        CHECK(container.rank(1000) == reference.rank(1000));
+        CHECK(container.select(777) == reference.select(777));
+        MagicalContainer::AscendingIterator ascIt(container);
+        ascIt += 500;
+        CHECK(*ascIt == reference.select(500));
+        CHECK(ascIt[-7] == reference.select(493));
+        CHECK(MagicalContainer::AscendingIterator(container).end() - ascIt == reference.size() - 500);
+        MagicalContainer::SideCrossIterator crossIt(container);
+        MagicalContainer::SideCrossIterator crossRef(reference);
+        CHECK(crossIt[101] == crossRef[101]);
+        vector<int> filled(40);
+        vector<int> expected(40);
+        MagicalContainer::PrimeIterator primeIt(container);
+        MagicalContainer::PrimeIterator primeRef(reference);
+        CHECK(primeIt.fill(filled) == primeRef.fill(expected));
+        CHECK(filled == expected);
+        CHECK(crossIt.fill(filled) == crossRef.fill(expected));
+        CHECK(filled == expected);
+
+        // An iterator that already read sees the element added before it
+        MagicalContainer::AscendingIterator first(container);
+        CHECK(*first == reference.select(0));
+        container.addElement(-100);
+        CHECK(*first == -100);
+        CHECK(container.addElement(size_t{0}, 2003) == reference.addElement(size_t{0}, 2003) + 1);
+
+        // Buffered inserts go to the engine on flush
+        container.setInsertBuffer(16);
+        container.addElement(11);
+        CHECK(container.pendingCount() == 1);
+        CHECK(container.rank(12) == reference.rank(12) + 2);
+        container.flush();
+        CHECK(container.pendingCount() == 0);
+
+        // Only the vector storage has contiguous slots
+        CHECK_THROWS_AS(container.elementsView(), logic_error);
+        CHECK_THROWS_AS(container.nextPrimeIndex(0), logic_error);
+        CHECK_THROWS_AS(container.setTombstoneThreshold(0.5), logic_error);
+        CHECK_NOTHROW(container.setTombstoneThreshold(0));
+    }
+}
+
+TEST_CASE("Moving iterators between engine-backed containers") {
+    for (MagicalContainer::Storage storage : {MagicalContainer::Storage::Chunked, MagicalContainer::Storage::RunLength}) {
+        CAPTURE(static_cast<int>(storage));
+        // Same number of mutations, so both engines are at the same version
+        MagicalContainer large(storage);
+        MagicalContainer small(storage);
+        for (int value = 0; value < 2000; ++value) {
+            large.addElement(value);
+        }
+        for (int value = 0; value < 2000; ++value) {
+            small.addElement(value % 7);
+        }
+        // Both targets have read next to the rank they are about to be given
+        MagicalContainer::AscendingIterator fromLarge(large);
+        fromLarge += 1500;
+        CHECK(*fromLarge == 1500);
+        MagicalContainer::AscendingIterator fromSmall(small);
+        fromSmall += 1499;
+        CHECK(*fromSmall == 5);
+        fromSmall = std::move(fromLarge);
+        CHECK(*fromSmall == 1500);
+        CHECK(*++fromSmall == 1501);
+
+        MagicalContainer::PrimeIterator primeLarge(large);
+        MagicalContainer::PrimeIterator primeSmall(small);
+        for (int step = 0; step < 10; ++step) {
+            ++primeLarge;
+            ++primeSmall;
+        }
+        CHECK(*primeLarge == 31);
+        CHECK(*primeSmall == 2);
+        primeSmall = std::move(primeLarge);
+        CHECK(*primeSmall == 31);
+    }
+}
+
+TEST_CASE("Removing duplicates with removeAll") {
+    MagicalContainer container;
+    for (int value : {3, 7, 3, 1, 3, 9}) {
+        container.addElement(value);
+    }
+
+    SUBCASE("Every copy is removed") {
+        CHECK(container.removeAll(3) == 3);
+        CHECK(container.getElements() == vector<int>{1, 7, 9});
+    }
+
+    SUBCASE("removeElement removes a single copy") {
+        CHECK(container.removeElement(3));
+        CHECK(container.getElements() == vector<int>{1, 3, 3, 7, 9});
+    }
+
+    SUBCASE("Missing values throw") {
+        CHECK_THROWS_AS(container.removeAll(4), runtime_error);
+        CHECK_THROWS_AS(container.removeElement(100), runtime_error);
+        CHECK(container.size() == 6);
+    }
+}
+
+TEST_CASE("Non-throwing removal") {
+    MagicalContainer container;
+    for (int value : {2, 4, 4, 8}) {
+        container.addElement(value);
+    }
+
+    SUBCASE("tryRemove") {
+        CHECK(container.tryRemove(4));
+        CHECK_FALSE(container.tryRemove(5));
+        CHECK(container.getElements() == vector<int>{2, 4, 8});
+    }
+
+    SUBCASE("tryRemoveAll") {
+        Expected<size_t> removed = container.tryRemoveAll(4);
+        REQUIRE(removed.has_value());
+        CHECK(removed.value() == 2);
+
+        Expected<size_t> missing = container.tryRemoveAll(4);
+        CHECK_FALSE(missing);
+        CHECK(missing.error() == ContainerError::NotFound);
+        CHECK(missing.value_or(0) == 0);
+        CHECK_THROWS_AS(missing.value(), runtime_error);
+        CHECK(container.getElements() == vector<int>{2, 8});
+    }
+}
+
+TEST_CASE("PrimeSieve") {
+    SUBCASE("Agrees with trial division") {
+        PrimeSieve sieve(50000);
+        bool agrees = true;
+        for (int num = -5; num < 60000; ++num) {
+            agrees = agrees && sieve.isPrime(num) == isPrimeByTrialDivision(num);
+        }
+        CHECK(agrees);
+        CHECK(sieve.sievedUpTo() <= 50000);
+    }
+
+    SUBCASE("Values above the bound use the fallback") {
+        PrimeSieve sieve(100);
+        CHECK(sieve.isPrime(97));
+        CHECK(sieve.isPrime(2147483647));
+        CHECK_FALSE(sieve.isPrime(2147483645));
+        CHECK(sieve.sievedUpTo() <= 100);
+    }
+
+    SUBCASE("Shared by several threads") {
+        PrimeSieve sieve(1 << 20);
+        vector<int> counts(4, 0);
+        vector<thread> workers;
+        for (size_t worker = 0; worker < counts.size(); ++worker) {
+            workers.emplace_back([&sieve, &counts, worker] {
+                // Every thread walks the range in a different direction to race the growth
+                for (int i = 0; i < 200000; ++i) {
+                    int num = worker % 2 == 0 ? i : 199999 - i;
+                    counts[worker] += sieve.isPrime(num) ? 1 : 0;
+                }
+            });
+        }
+        for (thread &worker : workers) {
+            worker.join();
+        }
+        // There are 17984 primes below 200000
+        CHECK(counts == vector<int>(4, 17984));
+    }
+}
+
+TEST_CASE("Miller-Rabin primality") {
+    SUBCASE("Agrees with trial division on 32-bit values") {
+        bool agrees = true;
+        for (int num = -5; num < 100000; ++num) {
+            agrees = agrees && isPrimeMillerRabin(static_cast<uint64_t>(max(num, 0))) == isPrimeByTrialDivision(max(num, 0));
+        }
+        for (int num = 2147483647; num > 2147383647; num -= 7) {
+            agrees = agrees && isPrimeMillerRabin(static_cast<uint64_t>(num)) == isPrimeByTrialDivision(num);
+        }
+        CHECK(agrees);
+    }
+
+    SUBCASE("Strong pseudoprimes and 64-bit values") {
+        // Strong pseudoprimes to several small bases
+        CHECK_FALSE(isPrimeMillerRabin(3215031751ULL));
+        CHECK_FALSE(isPrimeMillerRabin(3825123056546413051ULL));
+        CHECK_FALSE(isPrimeMillerRabin(4294967297ULL)); // 641 * 6700417
+        CHECK(isPrimeMillerRabin(4294967291ULL));
+        CHECK(isPrimeMillerRabin(18446744073709551557ULL));
+        CHECK_FALSE(isPrimeMillerRabin(18446744073709551615ULL));
+    }
+}
+
+TEST_CASE("BitVector") {
+    BitVector bits;
+    vector<bool> expected;
+    mt19937 generator(1);
+
+    SUBCASE("Random inserts and erases match vector<bool>") {
+        bool matches = true;
+        for (int step = 0; step < 3000; ++step) {
+            size_t index = expected.empty() ? 0 : generator() % (expected.size() + 1);
+            if (step % 3 == 2 && !expected.empty()) {
+                index = min(index, expected.size() - 1);
+                size_t last = min(expected.size(), index + generator() % 100);
+                bits.erase(index, last);
+                expected.erase(expected.begin() + static_cast<ptrdiff_t>(index), expected.begin() + static_cast<ptrdiff_t>(last));
+            } else {
+                bool value = generator() % 2 == 0;
+                bits.insert(index, value);
+                expected.insert(expected.begin() + static_cast<ptrdiff_t>(index), value);
+            }
+            matches = matches && bits.size() == expected.size();
+        }
+        for (size_t i = 0; i < expected.size(); ++i) {
+            matches = matches && bits.test(i) == expected[i];
+        }
+        CHECK(matches);
+    }
+
+    SUBCASE("Out of range positions throw") {
+        bits.push_back(true);
+        CHECK_THROWS_AS(bits.insert(3, true), out_of_range);
+        CHECK_THROWS_AS(bits.erase(0, 2), out_of_range);
+    }
+}
+
+TEST_CASE("PrimeIterator uses the cached prime flags") {
+    MagicalContainer container;
+    for (int value : {9, 7, 4, 13}) {
+        container.addElement(value);
+    }
+    vector<int> batch = {2, 8, 11, 7, 1};
+    container.addElements(batch);
+    container.removeElement(4);
+    container.removeAll(7);
+    container.addElement(3);
+
+    vector<int> primes;
+    MagicalContainer::PrimeIterator it(container);
+    for (; it != MagicalContainer::PrimeIterator(container).end(); ++it) {
+        primes.push_back(*it);
+    }
+    CHECK(primes == vector<int>{2, 3, 11, 13});
+
+    // Dereferencing does not move the iterator, so it works through a const iterator like the other two
+    const MagicalContainer::PrimeIterator first(container);
+    CHECK(*first == 2);
+    CHECK(*first == 2);
+}
+
+TEST_CASE("Prime position index") {
+    MagicalContainer container;
+    mt19937 generator(3);
+    vector<int> reference;
+
+    SUBCASE("Random inserts and removals keep the prime order") {
+        for (int step = 0; step < 2000; ++step) {
+            int value = static_cast<int>(generator() % 200);
+            if (step % 4 == 3 && container.tryRemove(value)) {
+                reference.erase(find(reference.begin(), reference.end(), value));
+            } else if (step % 4 != 3) {
+                container.addElement(value);
+                reference.push_back(value);
+            }
+        }
+        sort(reference.begin(), reference.end());
+        vector<int> expected;
+        copy_if(reference.begin(), reference.end(), back_inserter(expected), [](int value) { return isPrime(value); });
+
+        vector<int> primes;
+        MagicalContainer::PrimeIterator it(container);
+        for (; it != MagicalContainer::PrimeIterator(container).end(); ++it) {
+            primes.push_back(*it);
+        }
+        CHECK(primes == expected);
+    }
+
+    SUBCASE("A single prime among composites") {
+        for (int value = 4; value < 2000; value += 2) {
+            container.addElement(value);
+        }
+        container.addElement(1009);
+        MagicalContainer::PrimeIterator it(container);
+        CHECK(*it == 1009);
+        ++it;
+        CHECK(it == it.end());
+    }
+}
+
+TEST_CASE("Scanning primes through the prime flags") {
+    MagicalContainer container;
+    for (int value = 0; value < 300; ++value) {
+        container.addElement(value * 3 + 1);
+    }
+    vector<int> expected;
+    MagicalContainer::PrimeIterator it(container);
+    for (; it != MagicalContainer::PrimeIterator(container).end(); ++it) {
+        expected.push_back(*it);
+    }
+
+    SUBCASE("nextPrimeIndex walks every prime") {
+        vector<int> primes;
+        for (size_t index = container.nextPrimeIndex(0); index < static_cast<size_t>(container.size());
+             index = container.nextPrimeIndex(index + 1)) {
+            primes.push_back(container.elements[index]);
+        }
+        CHECK(primes == expected);
+    }
+
+    SUBCASE("scanPrimes fills the buffer in batches") {
+        vector<int> primes;
+        vector<int> buffer(7);
+        size_t from = 0;
+        size_t copied = 0;
+        while ((copied = container.scanPrimes(from, buffer)) > 0) {
+            primes.insert(primes.end(), buffer.begin(), buffer.begin() + static_cast<ptrdiff_t>(copied));
+        }
+        CHECK(primes == expected);
+        CHECK(from == static_cast<size_t>(container.size()));
+    }
+}
+
+TEST_CASE("Derived comparison operators") {
+    MagicalContainer container;
+    for (int value : {1, 2, 4, 5, 14}) {
+        container.addElement(value);
+    }
+    MagicalContainer::AscendingIterator first(container);
+    MagicalContainer::AscendingIterator second(container);
+    ++second;
+
+    CHECK(first <= second);
+    CHECK(first <= first);
+    CHECK_FALSE(first >= second);
+    CHECK(second >= first);
+    CHECK(second > first);
+    CHECK(first != second);
+
+    MagicalContainer other;
+    other.addElement(1);
+    MagicalContainer::SideCrossIterator crossIt(container);
+    MagicalContainer::SideCrossIterator otherIt(other);
+    CHECK_THROWS_AS((void)(crossIt > otherIt), runtime_error);
+}
+
+TEST_CASE("Range views over every order") {
+    MagicalContainer container;
+    for (int value : {1, 2, 4, 5, 14}) {
+        container.addElement(value);
+    }
+
+    SUBCASE("Each view walks its order") {
+        vector<int> ascending;
+        ranges::copy(container.ascending(), back_inserter(ascending));
+        CHECK(ascending == vector<int>{1, 2, 4, 5, 14});
+        vector<int> cross;
+        ranges::copy(container.sideCross(), back_inserter(cross));
+        CHECK(cross == vector<int>{1, 14, 2, 5, 4});
+        vector<int> primes;
+        ranges::copy(container.primes(), back_inserter(primes));
+        CHECK(primes == vector<int>{2, 5});
+        CHECK(container.primes().size() == 2);
+    }
+
+    SUBCASE("Views compose with range adaptors and algorithms") {
+        vector<int> doubled;
+        ranges::copy(container.sideCross() | views::take(3) | views::transform([](int value) { return value * 2; }),
+                     back_inserter(doubled));
+        CHECK(doubled == vector<int>{2, 28, 4});
+        CHECK(ranges::count_if(container.ascending(), [](int value) { return value % 2 == 0; }) == 3);
+        CHECK(*ranges::max_element(container.primes()) == 5);
+    }
+
+    SUBCASE("A view sees elements added after it was created") {
+        auto primes = container.primes();
+        container.addElement(7);
+        CHECK(ranges::distance(primes) == 3);
+        CHECK(ranges::distance(container.ascending()) == 6);
+    }
+
+    SUBCASE("Empty container") {
+        MagicalContainer empty;
+        CHECK(empty.ascending().empty());
+        CHECK(empty.sideCross().begin() == empty.sideCross().end());
+    }
+}
+
+TEST_CASE("Batched fill on every iterator") {
+    MagicalContainer container;
+    for (int value : {1, 2, 3, 4, 5, 7, 14}) {
+        container.addElement(value);
+    }
+    vector<int> buffer(3);
+
+    SUBCASE("Ascending") {
+        MagicalContainer::AscendingIterator it(container);
+        ++it;
+        CHECK(it.fill(buffer) == 3);
+        CHECK(buffer == vector<int>{2, 3, 4});
+        CHECK(*it == 5);
+        CHECK(it.fill(buffer) == 3);
+        CHECK(it.fill(buffer) == 0);
+        CHECK(it == it.end());
+    }
+
+    SUBCASE("Side cross") {
+        MagicalContainer::SideCrossIterator it(container);
+        vector<int> all;
+        size_t copied = 0;
+        while ((copied = it.fill(buffer)) > 0) {
+            all.insert(all.end(), buffer.begin(), buffer.begin() + static_cast<ptrdiff_t>(copied));
+        }
+        CHECK(all == vector<int>{1, 14, 2, 7, 3, 5, 4});
+        CHECK(it == MagicalContainer::SideCrossIterator(container).end());
+    }
+
+    SUBCASE("Side cross continues after single steps") {
+        MagicalContainer::SideCrossIterator it(container);
+        ++it;
+        CHECK(it.fill(buffer) == 3);
+        CHECK(buffer == vector<int>{14, 2, 7});
+        CHECK(*it == 3);
+    }
+
+    SUBCASE("Prime") {
+        MagicalContainer::PrimeIterator it(container);
+        vector<int> primes(10);
+        CHECK(it.fill(primes) == 4);
+        primes.resize(4);
+        CHECK(primes == vector<int>{2, 3, 5, 7});
+        CHECK(it == it.end());
+    }
+
+    SUBCASE("Prime past the last prime after removals") {
+        MagicalContainer::PrimeIterator it(container);
+        ++it;
+        ++it;
+        ++it;
+        container.removeElement(2);
+        container.removeElement(3);
+        CHECK(it.fill(buffer) == 0);
+    }
+}
+
+TEST_CASE("Iterators stay valid while the container grows") {
+    MagicalContainer container;
+    container.addElement(1);
+    container.addElement(2);
+
+    SUBCASE("Ascending sees elements added after it was created") {
+        MagicalContainer::AscendingIterator it(container);
+        ++it;
+        // Enough insertions to force 'elements' to reallocate
+        for (int value = 100; value < 1100; ++value) {
+            container.addElement(value);
+        }
+        CHECK(*it == 2);
+        ++it;
+        CHECK(*it == 100);
+    }
+
+    SUBCASE("Side cross and prime iterators keep their position") {
+        MagicalContainer::SideCrossIterator crossIt(container);
+        MagicalContainer::PrimeIterator primeIt(container);
+        for (int value = 3; value < 1000; ++value) {
+            container.addElement(value);
+        }
+        ++crossIt;
+        CHECK(*crossIt == 999);
+        ++primeIt;
+        CHECK(*primeIt == 3);
+        container.removeElement(999);
+        CHECK(*crossIt == 998);
+    }
+
+    SUBCASE("Cross order compares positions, not sides") {
+        for (int value : {4, 5, 14}) {
+            container.addElement(value);
+        }
+        // Cross order: 1, 14, 2, 5, 4
+        MagicalContainer::SideCrossIterator fourteen(container);
+        ++fourteen;
+        MagicalContainer::SideCrossIterator four(container);
+        ++(++(++(++four)));
+        CHECK(*four == 4);
+        CHECK(four > fourteen);
+        CHECK(fourteen < four);
+    }
+}
+
+TEST_CASE("OrderStatisticTree") {
+    OrderStatisticTree tree;
+    MagicalContainer container;
+    MagicalContainer treeBacked(MagicalContainer::Storage::OrderStatistic);
+    mt19937 generator(5);
+    bool sameErase = true;
+    for (int step = 0; step < 3000; ++step) {
+        int value = static_cast<int>(generator() % 500) - 100;
+        if (step % 3 == 2) {
+            sameErase = tree.erase(value) == container.tryRemove(value) && sameErase;
+            treeBacked.tryRemove(value);
+        } else {
+            tree.insert(value);
+            container.addElement(value);
+            treeBacked.addElement(value);
+        }
+    }
+
+    SUBCASE("Matches the vector backend") {
+        CHECK(sameErase);
+        CHECK(tree.size() == static_cast<size_t>(container.size()));
+        CHECK(tree.toVector() == container.getElements());
+        bool matches = true;
+        for (int value = -120; value < 420; value += 7) {
+            matches = matches && tree.rank(value) == container.rank(value);
+            matches = matches && tree.contains(value) == (container.rank(value + 1) > container.rank(value));
+        }
+        for (size_t rank = 0; rank < tree.size(); rank += 13) {
+            matches = matches && tree.select(rank) == container.select(rank);
+        }
+        CHECK(matches);
+        CHECK_THROWS_AS(tree.select(tree.size()), out_of_range);
+        CHECK_THROWS_AS(container.select(tree.size()), out_of_range);
+    }
+
+    SUBCASE("Select descends from the root and leaves the hint alone") {
+        SeekHint hint;
+        CHECK(tree.select(10, hint) == container.select(10));
+        CHECK(tree.selectPrime(0, hint) == *container.primes().begin());
+        CHECK_FALSE(hint.at(10));
+        CHECK_FALSE(hint.at(0));
+    }
+
+    SUBCASE("Container iterators walk every order by rank") {
+        vector<int> cross;
+        for (MagicalContainer::SideCrossIterator crossIt(treeBacked);
+             crossIt != MagicalContainer::SideCrossIterator(treeBacked).end(); ++crossIt) {
+            cross.push_back(*crossIt);
+        }
+        vector<int> expectedCross;
+        ranges::copy(container.sideCross(), back_inserter(expectedCross));
+        CHECK(cross == expectedCross);
+
+        vector<int> primes;
+        for (MagicalContainer::PrimeIterator primeIt(treeBacked);
+             primeIt != MagicalContainer::PrimeIterator(treeBacked).end(); ++primeIt) {
+            primes.push_back(*primeIt);
+        }
+        vector<int> expectedPrimes;
+        ranges::copy(container.primes(), back_inserter(expectedPrimes));
+        CHECK(primes == expectedPrimes);
+
+        MagicalContainer::AscendingIterator first(treeBacked);
+        MagicalContainer::AscendingIterator second(treeBacked);
+        ++second;
+        CHECK(first < second);
+        CHECK(second > first);
+        CHECK(*first == tree.select(0));
+    }
+}
+
+TEST_CASE("Random access AscendingIterator") {
+    MagicalContainer container;
+    for (int value = 0; value < 100; ++value) {
+        container.addElement(value * 10);
+    }
+    MagicalContainer::AscendingIterator it(container);
+
+    SUBCASE("Jumping to a page") {
+        it += 40;
+        CHECK(*it == 400);
+        CHECK(it[5] == 450);
+        it -= 15;
+        CHECK(*it == 250);
+        --it;
+        CHECK(*it == 240);
+        CHECK(*(it + 10) == 340);
+        CHECK(*(it - 4) == 200);
+    }
+
+    SUBCASE("Distance and ordering") {
+        MagicalContainer::AscendingIterator last(container);
+        last.end();
+        CHECK(last - it == 100);
+        CHECK(std::distance(it, last) == 100);
+        CHECK((it <=> last) == strong_ordering::less);
+        CHECK((last - 1) < last);
+        CHECK(*(last - 1) == 990);
+    }
+
+    SUBCASE("Jumps past either end throw") {
+        CHECK_THROWS_AS(it += 101, runtime_error);
+        CHECK_THROWS_AS(it -= 1, runtime_error);
+        CHECK_NOTHROW(it += 100);
+        CHECK(it == it.end());
+    }
+
+    SUBCASE("Standard random access algorithms") {
+        MagicalContainer::AscendingIterator last(container);
+        last.end();
+        CHECK(*std::lower_bound(it, last, 555) == 560);
+        CHECK(std::ranges::binary_search(it, last, 730));
+        CHECK(*(3 + it) == 30);
+        CHECK(*it++ == 0);
+        CHECK(*it-- == 10);
+        CHECK(*it == 0);
+    }
+}
+
+TEST_CASE("Random access SideCrossIterator") {
+    MagicalContainer container;
+    for (int value : {1, 2, 4, 5, 14}) {
+        container.addElement(value);
+    }
+    // Cross order: 1, 14, 2, 5, 4
+    MagicalContainer::SideCrossIterator it(container);
+
+    SUBCASE("Closed form jumps") {
+        CHECK(it[3] == 5);
+        it += 4;
+        CHECK(*it == 4);
+        it -= 3;
+        CHECK(*it == 14);
+        --it;
+        CHECK(*it == 1);
+        CHECK(*(it + 2) == 2);
+    }
+
+    SUBCASE("Distance, ordering and bounds") {
+        MagicalContainer::SideCrossIterator last(container);
+        last.end();
+        CHECK(last - it == 5);
+        CHECK(std::distance(it, last) == 5);
+        CHECK((it + 2 <=> it + 1) == strong_ordering::greater);
+        CHECK_THROWS_AS(it += 6, runtime_error);
+        CHECK_THROWS_AS(--it, runtime_error);
+    }
+
+    SUBCASE("Postfix steps and reversed traversal") {
+        MagicalContainer::SideCrossIterator last(container);
+        last.end();
+        CHECK(*it++ == 1);
+        CHECK(*(2 + it) == 5);
+        vector<int> reversed(std::make_reverse_iterator(last), std::make_reverse_iterator(it));
+        CHECK(reversed == vector<int>{4, 5, 2, 14});
+    }
+}
+
+TEST_CASE("Splitting orders and parallel_for_each") {
+    MagicalContainer container;
+    for (int value = 1; value <= 1000; ++value) {
+        container.addElement(value);
+    }
+
+    SUBCASE("split halves the remaining positions") {
+        auto whole = container.sideCross().spliterator();
+        auto prefix = whole.split();
+        CHECK(prefix.size() == 500);
+        CHECK(whole.size() == 500);
+        vector<int> seen;
+        prefix.forEachRemaining([&](int value) { seen.push_back(value); });
+        whole.forEachRemaining([&](int value) { seen.push_back(value); });
+        CHECK(seen.size() == 1000);
+        CHECK(seen[0] == 1);
+        CHECK(seen[1] == 1000);
+        CHECK(prefix.size() == 0);
+
+        auto primes = container.primes().spliterator();
+        auto firstPrimes = primes.split();
+        CHECK(firstPrimes.size() + primes.size() == 168);
+    }
+
+    SUBCASE("Every element is visited once") {
+        ThreadPool pool(4);
+        atomic<long long> sum(0);
+        atomic<size_t> visits(0);
+        parallel_for_each(container.ascending(), [&](int value) {
+            sum += value;
+            ++visits;
+        }, {&pool, 0, 16});
+        CHECK(sum == 500500);
+        CHECK(visits == 1000);
+
+        atomic<size_t> primes(0);
+        parallel_for_each(container.primes(), [&](int) { ++primes; }, {&pool, 0, 8});
+        CHECK(primes == 168);
+    }
+
+    SUBCASE("Exceptions reach the caller") {
+        ThreadPool pool(2);
+        CHECK_THROWS_AS(parallel_for_each(container.sideCross(), [](int value) {
+            if (value == 777) {
+                throw runtime_error("stop");
+            }
+        }, {&pool, 0, 10}), runtime_error);
+    }
+}
+
+TEST_CASE("WorkStealingDeque") {
+    WorkStealingDeque<int> deque(4);
+    for (int value = 0; value < 10; ++value) {
+        deque.push(value);
+    }
+    int value = -1;
+    CHECK(deque.pop(value));
+    CHECK(value == 9);
+    CHECK(deque.steal(value));
+    CHECK(value == 0);
+
+    // Thieves and the owner together take every value exactly once
+    atomic<int> taken(0);
+    atomic<long long> sum(0);
+    vector<thread> thieves;
+    for (int i = 0; i < 3; ++i) {
+        thieves.emplace_back([&] {
+            int stolen = 0;
+            while (taken < 10000) {
+                if (deque.steal(stolen)) {
+                    sum += stolen;
+                    ++taken;
+                }
+            }
+        });
+    }
+    for (int next = 0; next < 10000; ++next) {
+        deque.push(next);
+        if (next % 3 == 0 && deque.pop(value)) {
+            sum += value;
+            ++taken;
+        }
+    }
+    while (deque.pop(value)) {
+        sum += value;
+        ++taken;
+    }
+    for (thread &thief : thieves) {
+        thief.join();
+    }
+    CHECK(taken == 10000 + 8);
+    CHECK(sum == 49995000LL + 36);
+}
+
+TEST_CASE("Parallel algorithms") {
+    MagicalContainer container;
+    vector<int> values;
+    for (int value = -500; value < 5000; ++value) {
+        values.push_back(value);
+    }
+    container.addElements(values);
+    ThreadPool pool(3);
+    ParallelPolicy parallel{&pool, 0, 64};
+    ParallelPolicy sequential{&pool, 1000000};
+
+    for (const ParallelPolicy &policy : {parallel, sequential}) {
+        CHECK(parallel_sum(container, policy) == 12372250LL);
+        CHECK(parallel_count_if(container, [](int value) { return value < 0; }, policy) == 500);
+
+        vector<long long> doubled(values.size() + 5, 0);
+        CHECK(parallel_transform_into(container, span<long long>(doubled), [](int value) {
+            return 2LL * value;
+        }, policy) == values.size());
+        CHECK(doubled.front() == -1000);
+        CHECK(doubled[values.size() - 1] == 9998);
+        CHECK(doubled.back() == 0);
+
+        vector<uint8_t> flags = parallel_classify_primes(container, policy);
+        REQUIRE(flags.size() == values.size());
+        CHECK(std::count(flags.begin(), flags.end(), 1) == 669);
+        CHECK(flags[static_cast<size_t>(500 + 7)] == 1);
+        CHECK(flags[static_cast<size_t>(500 - 7)] == 0);
+        vector<uint8_t> checked(values.size());
+        parallel_classify_primes(container.elementsView(), span<uint8_t>(checked), policy);
+        CHECK(flags == checked);
+    }
+
+    container.setInsertBuffer(4);
+    container.addElement(3);
+    CHECK_THROWS_AS(parallel_classify_primes(container), logic_error);
+    container.flush();
+    CHECK(container.primePositionsView().size() == 670);
+}
+
+TEST_CASE("Parallel bulk ingestion") {
+    mt19937 generator(7);
+    uniform_int_distribution<int> distribution(-2000, 20000);
+    vector<int> preload;
+    vector<int> batch;
+    for (int i = 0; i < 3000; ++i) {
+        preload.push_back(distribution(generator));
+    }
+    for (int i = 0; i < 50000; ++i) {
+        batch.push_back(distribution(generator));
+    }
+
+    MagicalContainer sequential;
+    sequential.addElements(preload);
+    sequential.addElements(batch);
+
+    ThreadPool pool(3);
+    MagicalContainer parallel;
+    parallel.addElements(preload);
+    parallel.addElements(batch, ParallelPolicy{&pool, 0, 1000});
+
+    CHECK(parallel.elements == sequential.elements);
+    vector<int> expectedPrimes;
+    vector<int> actualPrimes;
+    ranges::copy(sequential.primes(), back_inserter(expectedPrimes));
+    ranges::copy(parallel.primes(), back_inserter(actualPrimes));
+    CHECK(actualPrimes == expectedPrimes);
+
+    // Still a regular container afterwards
+    parallel.addElement(19);
+    CHECK(parallel.rank(19) == sequential.rank(19));
+    CHECK(parallel.size() == sequential.size() + 1);
+}
+
+TEST_CASE("Radix sort") {
+    mt19937 generator(3);
+    uniform_int_distribution<int> any(numeric_limits<int>::min(), numeric_limits<int>::max());
+    vector<int> values;
+    for (int i = 0; i < 20000; ++i) {
+        values.push_back(i % 5 == 0 ? any(generator) % 100 : any(generator));
+    }
+    values.push_back(numeric_limits<int>::min());
+    values.push_back(numeric_limits<int>::max());
+    values.push_back(-1);
+    values.push_back(0);
+
+    vector<int> expected = values;
+    std::sort(expected.begin(), expected.end());
+
+    SUBCASE("Negative and extreme values") {
+        radixSort(values);
+        CHECK(values == expected);
+    }
+
+    SUBCASE("Values sharing high digits") {
+        vector<int> small = {5, -3, 2047, 2048, -2049, 0, 5};
+        radixSort(small);
+        CHECK(small == vector<int>{-2049, -3, 0, 5, 5, 2047, 2048});
+    }
+
+    SUBCASE("sortIntegers and bulk insert") {
+        vector<int> copy = values;
+        sortIntegers(copy);
+        CHECK(copy == expected);
+
+        MagicalContainer container;
+        container.addElements(values);
+        CHECK(container.elements == expected);
+    }
+}
+
+TEST_CASE("Zero-copy element access") {
+    MagicalContainer container;
+    container.addElements(vector<int>{9, 2, 7, 4});
+
+    span<const int> view = container.elementsView();
+    CHECK(view.size() == 4);
+    CHECK(view.data() == container.elements.data());
+    CHECK(ranges::equal(view, vector<int>{2, 4, 7, 9}));
+
+    vector<int> visited;
+    for (int value : container) {
+        visited.push_back(value);
+    }
+    CHECK(visited == container.getElements());
+    CHECK(*ranges::max_element(container) == 9);
+}
+
+TEST_CASE("Hinted and appending insertion") {
+    MagicalContainer plain;
+    MagicalContainer hinted;
+    mt19937 generator(11);
+    uniform_int_distribution<int> noise(-20, 20);
+    uniform_int_distribution<size_t> anywhere(0, 3000);
+    size_t hint = 0;
+    bool indicesMatch = true;
+    for (int i = 0; i < 2000; ++i) {
+        // Mostly ascending with some values arriving late, and now and then a useless hint
+        int value = i * 3 + noise(generator);
+        plain.addElement(value);
+        size_t index = hinted.addElement(i % 50 == 0 ? anywhere(generator) : hint, value);
+        indicesMatch = indicesMatch && hinted.elements[index] == value;
+        hint = index + 1;
+    }
+    CHECK(indicesMatch);
+    CHECK(hinted.elements == plain.elements);
+
+    vector<int> expectedPrimes;
+    vector<int> actualPrimes;
+    ranges::copy(plain.primes(), back_inserter(expectedPrimes));
+    ranges::copy(hinted.primes(), back_inserter(actualPrimes));
+    CHECK(actualPrimes == expectedPrimes);
+
+    // Equal values go after the existing copies whatever the hint
+    MagicalContainer duplicates;
+    duplicates.addElements(vector<int>{1, 5, 5, 9});
+    CHECK(duplicates.addElement(0, 5) == 3);
+    CHECK(duplicates.addElement(10, 5) == 4);
+    CHECK(duplicates.addElement(2, 11) == 6);
+    CHECK(duplicates.elements == vector<int>{1, 5, 5, 5, 5, 9, 11});
+}
+
+TEST_CASE("RunLengthStorage") {
+    RunLengthStorage storage;
+    MagicalContainer runContainer(MagicalContainer::Storage::RunLength);
+    for (int value : {7, 4, 7, 7, 9, 4, 2, 7, 13}) {
+        storage.insert(value);
+        runContainer.addElement(value);
+    }
+    // Ascending: 2, 4, 4, 7, 7, 7, 7, 9, 13
+    CHECK(storage.size() == 9);
+    CHECK(storage.runCount() == 5);
+    CHECK(storage.count(7) == 4);
+    CHECK(storage.primeCount() == 6);
+
+    SUBCASE("Container iterators walk the runs") {
+        vector<int> ascending;
+        for (MagicalContainer::AscendingIterator it(runContainer); it != MagicalContainer::AscendingIterator(runContainer).end(); ++it) {
+            ascending.push_back(*it);
+        }
+        CHECK(ascending == storage.toVector());
+        CHECK(ascending == vector<int>{2, 4, 4, 7, 7, 7, 7, 9, 13});
+
+        vector<int> cross;
+        for (MagicalContainer::SideCrossIterator it(runContainer); it != MagicalContainer::SideCrossIterator(runContainer).end(); ++it) {
+            cross.push_back(*it);
+        }
+        CHECK(cross == vector<int>{2, 13, 4, 9, 4, 7, 7, 7, 7});
+
+        vector<int> primes;
+        for (MagicalContainer::PrimeIterator it(runContainer); it != MagicalContainer::PrimeIterator(runContainer).end(); ++it) {
+            primes.push_back(*it);
+        }
+        CHECK(primes == vector<int>{2, 7, 7, 7, 7, 13});
+        CHECK_THROWS(*MagicalContainer::PrimeIterator(runContainer).end());
+    }
+
+    SUBCASE("Counters and runs follow insert and erase") {
+        storage.insert(7);
+        CHECK(storage.runCount() == 5);
+        CHECK(storage.erase(2));
+        CHECK(storage.runCount() == 4);
+        CHECK_FALSE(storage.erase(2));
+        CHECK(storage.primeCount() == 6);
+        storage.insert(-3);
+        storage.insert(3);
+        CHECK(storage.primeCount() == 7);
+        CHECK(storage.toVector() == vector<int>{-3, 3, 4, 4, 7, 7, 7, 7, 7, 9, 13});
+
+        runContainer.addElement(7);
+        runContainer.removeElement(2);
+        runContainer.addElement(-3);
+        runContainer.addElement(3);
+        vector<int> primes;
+        for (MagicalContainer::PrimeIterator it(runContainer); it != MagicalContainer::PrimeIterator(runContainer).end(); ++it) {
+            primes.push_back(*it);
+        }
+        CHECK(primes == vector<int>{3, 7, 7, 7, 7, 7, 13});
+    }
+
+    SUBCASE("Order statistics step through the runs") {
+        SeekHint hint;
+        CHECK(storage.rank(7) == 3);
+        CHECK(storage.select(6, hint) == 7);
+        CHECK(storage.select(7, hint) == 9);
+        CHECK(storage.select(6, hint) == 7);
+        CHECK(storage.select(2, hint) == 4);
+        CHECK(storage.select(1, hint) == 4);
+        CHECK(storage.select(0, hint) == 2);
+        SeekHint primeHint;
+        CHECK(storage.selectPrime(4, primeHint) == 7);
+        CHECK(storage.selectPrime(5, primeHint) == 13);
+        CHECK_THROWS_AS(storage.select(9, hint), out_of_range);
+        CHECK(storage.eraseAll(7) == 4);
+        CHECK(storage.eraseAll(7) == 0);
+        CHECK(storage.primeCount() == 2);
+        CHECK(storage.toVector() == vector<int>{2, 4, 4, 9, 13});
+    }
+}
+
+TEST_CASE("Buffered inserts") {
+    MagicalContainer container;
+    container.setInsertBuffer(4);
+    CHECK(container.insertBuffer() == 4);
+    MagicalContainer::AscendingIterator ascIt(container);
+    MagicalContainer::PrimeIterator primeIt(container);
+
+    container.addElement(14);
+    container.addElement(1);
+    container.addElement(5);
+    CHECK(container.pendingCount() == 3);
+    CHECK(container.size() == 3);
+
+    SUBCASE("Iterators created earlier see the buffered elements") {
+        CHECK(*ascIt == 1);
+        CHECK(container.pendingCount() == 0);
+        container.addElement(2);
+        container.addElement(4);
+        vector<int> ascending;
+        for (auto it = ascIt.begin(); it != MagicalContainer::AscendingIterator(container).end(); ++it) {
+            ascending.push_back(*it);
+        }
+        CHECK(ascending == vector<int>{1, 2, 4, 5, 14});
+        CHECK(*primeIt == 2);
+        CHECK(ranges::equal(container.sideCross(), vector<int>{1, 14, 2, 5, 4}));
+    }
+
+    SUBCASE("The buffer merges when full") {
+        container.addElement(3);
+        CHECK(container.pendingCount() == 0);
+        CHECK(container.elements == vector<int>{1, 3, 5, 14});
+        container.addElement(7);
+        CHECK(container.rank(7) == 3);
+        CHECK(container.select(2) == 5);
+        CHECK(container.getElements() == vector<int>{1, 3, 5, 7, 14});
+        CHECK_THROWS_AS(container.elementsView(), logic_error);
+        CHECK_THROWS_AS(container.primes().size(), logic_error);
+        container.flush();
+        CHECK(ranges::equal(container.primes(), vector<int>{3, 5, 7}));
+    }
+
+    SUBCASE("Rank and removal work on the buffer in place") {
+        CHECK(container.rank(6) == 2);
+        CHECK(container.tryRemove(14));
+        CHECK(container.removeAll(1) == 1);
+        CHECK(container.pendingCount() == 1);
+        CHECK_FALSE(container.tryRemove(14));
+        CHECK(container.size() == 1);
+    }
+
+    SUBCASE("Removal and turning the buffer off") {
+        container.removeElement(5);
+        CHECK(container.getElements() == vector<int>{1, 14});
+        container.addElement(9);
+        container.setInsertBuffer(0);
+        CHECK(container.pendingCount() == 0);
+        container.addElement(0);
+        CHECK(container.elements == vector<int>{0, 1, 9, 14});
+    }
+}
+
+TEST_CASE("Tombstone deletion") {
+    MagicalContainer container;
+    vector<int> values;
+    for (int value = 1; value <= 20; ++value) {
+        values.push_back(value);
+    }
+    container.addElements(values);
+    container.setTombstoneThreshold(0.5);
+    CHECK(container.tombstoneThreshold() == 0.5);
+    CHECK_THROWS_AS(container.setTombstoneThreshold(1.5), invalid_argument);
+
+    for (int value : {2, 3, 4, 10, 11}) {
+        container.removeElement(value);
+    }
+    CHECK(container.size() == 15);
+    CHECK(container.deadRatio() == doctest::Approx(0.25));
+    CHECK(container.compactionStats().compactions == 0);
+    CHECK_FALSE(container.tryRemove(3));
+
+    SUBCASE("Iterators skip dead slots") {
+        vector<int> ascending;
+        MagicalContainer::AscendingIterator ascIt(container);
+        for (auto it = ascIt.begin(); it != MagicalContainer::AscendingIterator(container).end(); ++it) {
+            ascending.push_back(*it);
+        }
+        CHECK(ascending == vector<int>{1, 5, 6, 7, 8, 9, 12, 13, 14, 15, 16, 17, 18, 19, 20});
+
+        vector<int> primes;
+        MagicalContainer::PrimeIterator primeIt(container);
+        for (auto it = primeIt.begin(); it != MagicalContainer::PrimeIterator(container).end(); ++it) {
+            primes.push_back(*it);
+        }
+        CHECK(primes == vector<int>{5, 7, 13, 17, 19});
+        CHECK(container.deadRatio() == doctest::Approx(0.25));
+    }
+
+    SUBCASE("Dense reads compact first") {
+        CHECK_THROWS_AS(container.sideCross().size(), logic_error);
+        MagicalContainer::SideCrossIterator crossIt(container);
+        CHECK(*++crossIt == 20);
+        CHECK(ranges::equal(container.sideCross(), vector<int>{1, 20, 5, 19, 6, 18, 7, 17, 8, 16, 9, 15, 12, 14, 13}));
+        CHECK(container.deadRatio() == 0);
+        CHECK(container.compactionStats().compactions == 1);
+        CHECK(container.compactionStats().slotsReclaimed == 5);
+        CHECK(container.elements.size() == 15);
+        container.addElement(3);
+        CHECK(container.rank(5) == 2);
+    }
+
+    SUBCASE("Inserts keep the dead slots") {
+        for (int round = 0; round < 8; ++round) {
+            container.removeElement(20);
+            container.addElement(20);
+        }
+        container.addElement(0, 3);
+        container.addElements(vector<int>{2, 21});
+        vector<int> batch(200, 11);
+        container.addElements(batch, ParallelPolicy{nullptr, 0, 50});
+        CHECK(container.compactionStats().compactions == 0);
+        CHECK(container.size() == 218);
+        CHECK(container.rank(5) == 3);
+        CHECK(container.select(3) == 5);
+        CHECK(container.select(208) == 12);
+        MagicalContainer::PrimeIterator primeIt(container);
+        vector<int> primes(8);
+        CHECK(primeIt.fill(primes) == 8);
+        CHECK(primes == vector<int>{2, 3, 5, 7, 11, 11, 11, 11});
+    }
+
+    SUBCASE("Random access and fill count live elements only") {
+        MagicalContainer::AscendingIterator ascIt(container);
+        ascIt.begin();
+        ascIt += 1;
+        CHECK(*ascIt == 5);
+        ascIt += 5;
+        CHECK(*ascIt == 12);
+        CHECK(ascIt[-1] == 9);
+        MagicalContainer::AscendingIterator first(container);
+        CHECK(ascIt - first.begin() == 6);
+        CHECK(MagicalContainer::AscendingIterator(container).end() - first == 15);
+
+        vector<int> buffer(4);
+        CHECK(first.fill(buffer) == 4);
+        CHECK(buffer == vector<int>{1, 5, 6, 7});
+        CHECK(first.fill(buffer) == 4);
+        CHECK(buffer == vector<int>{8, 9, 12, 13});
+        CHECK(*first == 14);
+
+        MagicalContainer::PrimeIterator primeIt(container);
+        vector<int> primes(10);
+        CHECK(primeIt.fill(primes) == 5);
+        primes.resize(5);
+        CHECK(primes == vector<int>{5, 7, 13, 17, 19});
+        CHECK(container.compactionStats().compactions == 0);
+    }
+
+    SUBCASE("Iterators start at the first live element after a buffered insert") {
+        container.setInsertBuffer(100);
+        container.addElement(30);
+        MagicalContainer::AscendingIterator ascIt(container);
+        ascIt.begin();
+        CHECK(*ascIt == 1);
+        container.removeElement(1);
+        CHECK(*ascIt.begin() == 5);
+        MagicalContainer::PrimeIterator primeIt(container);
+        primeIt.begin();
+        CHECK(*primeIt == 5);
+        CHECK(container.pendingCount() == 0);
+    }
+
+    SUBCASE("Crossing the threshold compacts") {
+        CHECK(container.removeAll(12) == 1);
+        for (int value : {13, 14, 15, 16, 17}) {
+            container.removeElement(value);
+        }
+        CHECK(container.compactionStats().compactions == 1);
+        CHECK(container.compactionStats().lastMs >= 0);
+        CHECK(container.deadRatio() == 0);
+        CHECK(container.getElements() == vector<int>{1, 5, 6, 7, 8, 9, 18, 19, 20});
+    }
+
+    SUBCASE("compact() and turning tombstones off") {
+        container.compact();
+        CHECK(container.elements.size() == 15);
+        container.removeElement(1);
+        container.setTombstoneThreshold(0);
+        CHECK(container.deadRatio() == 0);
+        container.removeElement(5);
+        CHECK(container.compactionStats().compactions == 2);
+        CHECK(container.getElements().front() == 6);
+    }
+}
@@ -0,0 +1,237 @@
+#include "BitVector.hpp"
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+#include <utility>
+
+namespace ariel
+{
+    namespace
+    {
+        // Mask of the 'count' lowest bits of a word
+        uint64_t lowMask(size_t count)
+        {
+            return count == 0 ? 0 : ~uint64_t{0} >> (BitVector::WORD_BITS - count);
+        }
+    }
+
+    BitVector::BitVector() : bits(0)
+    {
+    }
+
+    size_t BitVector::size() const
+    {
+        return bits;
+    }
+
+    bool BitVector::empty() const
+    {
+        return bits == 0;
+    }
+
+    bool BitVector::test(size_t index) const
+    {
+        return ((words[index / WORD_BITS] >> (index % WORD_BITS)) & 1U) != 0;
+    }
+
+    //index of the first set bit at or after 'from', size() when there is none
+    size_t BitVector::findNext(size_t from) const
+    {
+        if (from >= bits)
+        {
+            return bits;
+        }
+        size_t word = from / WORD_BITS;
+        // Ignore the bits before 'from' in the first word, then skip whole zero words
+        uint64_t current = words[word] & ~lowMask(from % WORD_BITS);
+        while (current == 0)
+        {
+            if (++word == words.size())
+            {
+                return bits;
+            }
+            current = words[word];
+        }
+        return word * WORD_BITS + static_cast<size_t>(std::countr_zero(current));
+    }
+
+    //index of the first clear bit at or after 'from', size() when there is none
+    size_t BitVector::findNextClear(size_t from) const
+    {
+        if (from >= bits)
+        {
+            return bits;
+        }
+        size_t word = from / WORD_BITS;
+        uint64_t current = ~words[word] & ~lowMask(from % WORD_BITS);
+        while (current == 0)
+        {
+            if (++word == words.size())
+            {
+                return bits;
+            }
+            current = ~words[word];
+        }
+        // The unused bits past size() read as clear, never report them
+        return std::min(bits, word * WORD_BITS + static_cast<size_t>(std::countr_zero(current)));
+    }
+
+    //number of set bits before 'last', one popcount per word
+    size_t BitVector::countSet(size_t last) const
+    {
+        last = std::min(last, bits);
+        size_t count = 0;
+        for (size_t word = 0; word < last / WORD_BITS; ++word)
+        {
+            count += static_cast<size_t>(std::popcount(words[word]));
+        }
+        if (last % WORD_BITS != 0)
+        {
+            count += static_cast<size_t>(std::popcount(words[last / WORD_BITS] & lowMask(last % WORD_BITS)));
+        }
+        return count;
+    }
+
+    //index of the clear bit with 'rank' clear bits before it, size() when there are not that many
+    size_t BitVector::findNthClear(size_t rank) const
+    {
+        for (size_t word = 0; word < words.size(); ++word)
+        {
+            uint64_t clear = ~words[word];
+            auto available = static_cast<size_t>(std::popcount(clear));
+            if (rank >= available)
+            {
+                rank -= available;
+                continue;
+            }
+            // Drop the lowest clear bits until the wanted one is the lowest
+            for (; rank > 0; --rank)
+            {
+                clear &= clear - 1;
+            }
+            return std::min(bits, word * WORD_BITS + static_cast<size_t>(std::countr_zero(clear)));
+        }
+        return bits;
+    }
+
+    void BitVector::set(size_t index, bool value)
+    {
+        uint64_t mask = uint64_t{1} << (index % WORD_BITS);
+        if (value)
+        {
+            words[index / WORD_BITS] |= mask;
+        }
+        else
+        {
+            words[index / WORD_BITS] &= ~mask;
+        }
+    }
+
+    void BitVector::push_back(bool value)
+    {
+        if (bits % WORD_BITS == 0)
+        {
+            words.push_back(0);
+        }
+        ++bits;
+        set(bits - 1, value);
+    }
+
+    //insert a bit at 'index', every following bit moves up by one
+    void BitVector::insert(size_t index, bool value)
+    {
+        if (index > bits)
+        {
+            throw std::out_of_range("BitVector insert position out of range");
+        }
+        push_back(false);
+        size_t word = index / WORD_BITS;
+        size_t offset = index % WORD_BITS;
+
+        // The first word keeps its low bits and shifts the rest up around the new bit
+        uint64_t carry = words[word] >> (WORD_BITS - 1);
+        uint64_t low = words[word] & lowMask(offset);
+        uint64_t high = words[word] & ~lowMask(offset);
+        words[word] = low | (high << 1U) | (uint64_t{value} << offset);
+
+        // Every following word shifts by one and takes the carry of the previous word
+        for (size_t next = word + 1; next < words.size(); ++next)
+        {
+            uint64_t nextCarry = words[next] >> (WORD_BITS - 1);
+            words[next] = (words[next] << 1U) | carry;
+            carry = nextCarry;
+        }
+    }
+
+    void BitVector::erase(size_t index)
+    {
+        erase(index, index + 1);
+    }
+
+    //remove the bits in [first, last), every following bit moves down
+    void BitVector::erase(size_t first, size_t last)
+    {
+        if (first > last || last > bits)
+        {
+            throw std::out_of_range("BitVector erase range out of range");
+        }
+        size_t removed = last - first;
+        if (removed == 0)
+        {
+            return;
+        }
+        size_t word = first / WORD_BITS;
+        size_t offset = first % WORD_BITS;
+        words[word] = (words[word] & lowMask(offset)) | (extract(last) << offset);
+        for (size_t next = word + 1; next < words.size(); ++next)
+        {
+            words[next] = extract(next * WORD_BITS + removed);
+        }
+        bits -= removed;
+        trimTail();
+    }
+
+    //the 64 bits starting at 'bitIndex', zero past the end
+    uint64_t BitVector::extract(size_t bitIndex) const
+    {
+        size_t word = bitIndex / WORD_BITS;
+        size_t offset = bitIndex % WORD_BITS;
+        uint64_t low = word < words.size() ? words[word] >> offset : 0;
+        uint64_t high = offset != 0 && word + 1 < words.size() ? words[word + 1] << (WORD_BITS - offset) : 0;
+        return low | high;
+    }
+
+    //drop unused words and clear the padding bits of the last one
+    void BitVector::trimTail()
+    {
+        words.resize((bits + WORD_BITS - 1) / WORD_BITS);
+        if (bits % WORD_BITS != 0)
+        {
+            words.back() &= lowMask(bits % WORD_BITS);
+        }
+    }
+
+    void BitVector::reserve(size_t capacity)
+    {
+        words.reserve((capacity + WORD_BITS - 1) / WORD_BITS);
+    }
+
+    //replace the contents with 'count' clear bits
+    void BitVector::assignZeros(size_t count)
+    {
+        words.assign((count + WORD_BITS - 1) / WORD_BITS, 0);
+        bits = count;
+    }
+
+    void BitVector::clear()
+    {
+        words.clear();
+        bits = 0;
+    }
+
+    void BitVector::swap(BitVector &other) noexcept
+    {
+        words.swap(other.words);
+        std::swap(bits, other.bits);
+    }
+}
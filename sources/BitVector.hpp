@@ -0,0 +1,46 @@
+#ifndef BIT_VECTOR_HPP
+#define BIT_VECTOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ariel
+{
+    using namespace std;
+
+    // Growable packed array of bits with positional insert and erase.
+    // Shifting after an insert or erase moves 64 bits per step instead of one.
+    class BitVector
+    {
+    private:
+        vector<uint64_t> words;
+        size_t bits;
+
+        uint64_t extract(size_t bitIndex) const;
+        void trimTail();
+
+    public:
+        static constexpr size_t WORD_BITS = 64;
+
+        BitVector();
+        size_t size() const;
+        bool empty() const;
+        bool test(size_t index) const;
+        size_t findNext(size_t from) const;
+        size_t findNextClear(size_t from) const;
+        size_t countSet(size_t last) const;
+        size_t findNthClear(size_t rank) const;
+        void set(size_t index, bool value);
+        void push_back(bool value);
+        void insert(size_t index, bool value);
+        void erase(size_t index);
+        void erase(size_t first, size_t last);
+        void reserve(size_t capacity);
+        void assignZeros(size_t count);
+        void clear();
+        void swap(BitVector &other) noexcept;
+    };
+} // namespace ariel
+
+#endif
@@ -0,0 +1,348 @@
+#include "ChunkedStorage.hpp"
+#include "Primality.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace ariel
+{
+    //constructor
+    ChunkedStorage::ChunkedStorage(size_t blockSize) : blockSize(blockSize), total(0), primes(0)
+    {
+        if (blockSize == 0)
+        {
+            throw std::invalid_argument("Block size must be positive");
+        }
+    }
+
+    //index of the block that holds (or should hold) the first copy of 'value'
+    size_t ChunkedStorage::findBlock(int value) const
+    {
+        auto it = std::lower_bound(blockMax.begin(), blockMax.end(), value);
+        size_t block = static_cast<size_t>(it - blockMax.begin());
+        // Values above every block maximum go into the last block
+        return block == blocks.size() && block > 0 ? block - 1 : block;
+    }
+
+    //add an element, only the elements and prime flags of one block are moved
+    void ChunkedStorage::insert(int value)
+    {
+        if (blocks.empty())
+        {
+            addBlock(0, vector<int>(), BitVector());
+        }
+        size_t block = findBlock(value);
+        vector<int> &target = blocks[block];
+        auto position = std::upper_bound(target.begin(), target.end(), value);
+        bool prime = isPrime(value);
+        blockPrimes[block].insert(static_cast<size_t>(position - target.begin()), prime);
+        target.insert(position, value);
+        blockMax[block] = target.back();
+        primeCounts[block] += prime ? 1 : 0;
+        primes += prime ? 1 : 0;
+        ++total;
+
+        // Keep blocks cache-sized: a full block is split into two halves
+        if (target.size() >= 2 * blockSize)
+        {
+            splitBlock(block);
+        }
+    }
+
+    //remove one copy of 'value', false when it is not stored
+    bool ChunkedStorage::erase(int value) noexcept
+    {
+        if (blocks.empty())
+        {
+            return false;
+        }
+        size_t block = findBlock(value);
+        vector<int> &target = blocks[block];
+        auto it = std::lower_bound(target.begin(), target.end(), value);
+        if (it == target.end() || *it != value)
+        {
+            return false;
+        }
+        auto offset = static_cast<size_t>(it - target.begin());
+        if (blockPrimes[block].test(offset))
+        {
+            --primeCounts[block];
+            --primes;
+        }
+        blockPrimes[block].erase(offset);
+        target.erase(it);
+        --total;
+
+        if (target.empty())
+        {
+            removeBlock(block);
+            return true;
+        }
+        blockMax[block] = target.back();
+        // Merge sparse neighbours so the index does not fill up with tiny blocks
+        if (block + 1 < blocks.size() && target.size() + blocks[block + 1].size() <= blockSize)
+        {
+            mergeWithNext(block);
+        }
+        return true;
+    }
+
+    //remove every copy of 'value', returns how many were stored
+    size_t ChunkedStorage::eraseAll(int value) noexcept
+    {
+        size_t removed = 0;
+        while (erase(value))
+        {
+            ++removed;
+        }
+        return removed;
+    }
+
+    //insert a block at index 'block' with room for two full blocks, so it only allocates here
+    void ChunkedStorage::addBlock(size_t block, vector<int> values, BitVector flags)
+    {
+        values.reserve(2 * blockSize);
+        flags.reserve(2 * blockSize);
+        size_t flagged = flags.countSet(flags.size());
+        auto offset = static_cast<std::ptrdiff_t>(block);
+        blockMax.insert(blockMax.begin() + offset, values.empty() ? 0 : values.back());
+        primeCounts.insert(primeCounts.begin() + offset, flagged);
+        blockPrimes.insert(blockPrimes.begin() + offset, std::move(flags));
+        blocks.insert(blocks.begin() + offset, std::move(values));
+    }
+
+    //erasing from the block index only moves the blocks, it never allocates
+    void ChunkedStorage::removeBlock(size_t block) noexcept
+    {
+        auto offset = static_cast<std::ptrdiff_t>(block);
+        blocks.erase(blocks.begin() + offset);
+        blockMax.erase(blockMax.begin() + offset);
+        blockPrimes.erase(blockPrimes.begin() + offset);
+        primeCounts.erase(primeCounts.begin() + offset);
+    }
+
+    void ChunkedStorage::splitBlock(size_t block)
+    {
+        vector<int> &full = blocks[block];
+        size_t middle = full.size() / 2;
+        vector<int> upper(full.begin() + static_cast<std::ptrdiff_t>(middle), full.end());
+        BitVector upperFlags;
+        for (size_t offset = middle; offset < full.size(); ++offset)
+        {
+            upperFlags.push_back(blockPrimes[block].test(offset));
+        }
+        full.erase(full.begin() + static_cast<std::ptrdiff_t>(middle), full.end());
+        blockPrimes[block].erase(middle, blockPrimes[block].size());
+        primeCounts[block] -= upperFlags.countSet(upperFlags.size());
+        blockMax[block] = full.back();
+        addBlock(block + 1, std::move(upper), std::move(upperFlags));
+    }
+
+    //append the next block to this one, both fit in the capacity this block reserved
+    void ChunkedStorage::mergeWithNext(size_t block)
+    {
+        vector<int> &next = blocks[block + 1];
+        for (size_t offset = 0; offset < next.size(); ++offset)
+        {
+            blockPrimes[block].push_back(blockPrimes[block + 1].test(offset));
+        }
+        blocks[block].insert(blocks[block].end(), next.begin(), next.end());
+        blockMax[block] = blocks[block].back();
+        primeCounts[block] += primeCounts[block + 1];
+        removeBlock(block + 1);
+    }
+
+    bool ChunkedStorage::contains(int value) const
+    {
+        if (blocks.empty())
+        {
+            return false;
+        }
+        const vector<int> &target = blocks[findBlock(value)];
+        return std::binary_search(target.begin(), target.end(), value);
+    }
+
+    //number of stored copies of 'value', they may run over several blocks
+    size_t ChunkedStorage::count(int value) const
+    {
+        size_t copies = 0;
+        for (size_t block = blocks.empty() ? 0 : findBlock(value); block < blocks.size(); ++block)
+        {
+            auto range = std::equal_range(blocks[block].begin(), blocks[block].end(), value);
+            copies += static_cast<size_t>(range.second - range.first);
+            if (range.second != blocks[block].end())
+            {
+                break;
+            }
+        }
+        return copies;
+    }
+
+    size_t ChunkedStorage::size() const
+    {
+        return total;
+    }
+
+    size_t ChunkedStorage::primeCount() const
+    {
+        return primes;
+    }
+
+    size_t ChunkedStorage::blockCount() const
+    {
+        return blocks.size();
+    }
+
+    //number of elements smaller than 'value': every block before its block holds only smaller values
+    size_t ChunkedStorage::rank(int value) const
+    {
+        if (blocks.empty())
+        {
+            return 0;
+        }
+        size_t block = findBlock(value);
+        size_t smaller = 0;
+        for (size_t before = 0; before < block; ++before)
+        {
+            smaller += blocks[before].size();
+        }
+        auto position = std::lower_bound(blocks[block].begin(), blocks[block].end(), value);
+        return smaller + static_cast<size_t>(position - blocks[block].begin());
+    }
+
+    //the element at 'rank' in ascending order, stepping from the hint when it is a neighbour
+    const int &ChunkedStorage::select(size_t rank, SeekHint &hint) const
+    {
+        if (rank >= total)
+        {
+            throw std::out_of_range("Rank out of range");
+        }
+        Position position{hint.outer, hint.inner};
+        if (hint.before(rank))
+        {
+            advance(position);
+        }
+        else if (hint.after(rank))
+        {
+            retreat(position);
+        }
+        else if (!hint.at(rank))
+        {
+            position = locate(rank);
+        }
+        hint = SeekHint{rank, position.block, position.offset};
+        return blocks[position.block][position.offset];
+    }
+
+    //the prime with 'primeRank' primes before it, the next one is found through the cached flags
+    const int &ChunkedStorage::selectPrime(size_t primeRank, SeekHint &hint) const
+    {
+        if (primeRank >= primes)
+        {
+            throw std::out_of_range("Prime rank out of range");
+        }
+        Position position{hint.outer, hint.inner};
+        if (hint.before(primeRank))
+        {
+            advance(position);
+            seekPrime(position);
+        }
+        else if (!hint.at(primeRank))
+        {
+            position = locatePrime(primeRank);
+        }
+        hint = SeekHint{primeRank, position.block, position.offset};
+        return blocks[position.block][position.offset];
+    }
+
+    //copy of all the elements in ascending order
+    vector<int> ChunkedStorage::toVector() const
+    {
+        vector<int> result;
+        result.reserve(total);
+        for (const vector<int> &block : blocks)
+        {
+            result.insert(result.end(), block.begin(), block.end());
+        }
+        return result;
+    }
+
+    ChunkedStorage::Position ChunkedStorage::past() const
+    {
+        return Position{blocks.size(), 0};
+    }
+
+    //move one element forward, crossing into the next block when needed
+    void ChunkedStorage::advance(Position &position) const
+    {
+        if (++position.offset == blocks[position.block].size())
+        {
+            ++position.block;
+            position.offset = 0;
+        }
+    }
+
+    //move one element backward, crossing into the previous block when needed
+    void ChunkedStorage::retreat(Position &position) const
+    {
+        if (position.offset > 0)
+        {
+            --position.offset;
+        }
+        else if (position.block > 0)
+        {
+            --position.block;
+            position.offset = blocks[position.block].size() - 1;
+        }
+        else
+        {
+            position = past();
+        }
+    }
+
+    //move to the first prime at or after 'position', skipping blocks without primes
+    void ChunkedStorage::seekPrime(Position &position) const
+    {
+        for (; position.block < blocks.size(); ++position.block, position.offset = 0)
+        {
+            if (primeCounts[position.block] > 0)
+            {
+                size_t offset = blockPrimes[position.block].findNext(position.offset);
+                if (offset < blocks[position.block].size())
+                {
+                    position.offset = offset;
+                    return;
+                }
+            }
+        }
+        position = past();
+    }
+
+    //position of the element at 'rank', walking the block sizes
+    ChunkedStorage::Position ChunkedStorage::locate(size_t rank) const
+    {
+        size_t block = 0;
+        while (rank >= blocks[block].size())
+        {
+            rank -= blocks[block++].size();
+        }
+        return Position{block, rank};
+    }
+
+    //position of the prime with 'primeRank' primes before it, walking the prime counts
+    ChunkedStorage::Position ChunkedStorage::locatePrime(size_t primeRank) const
+    {
+        size_t block = 0;
+        while (primeRank >= primeCounts[block])
+        {
+            primeRank -= primeCounts[block++];
+        }
+        Position position{block, 0};
+        seekPrime(position);
+        for (; primeRank > 0; --primeRank)
+        {
+            ++position.offset;
+            seekPrime(position);
+        }
+        return position;
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef CHUNKED_STORAGE_HPP
+#define CHUNKED_STORAGE_HPP
+
+#include <vector>
+#include <cstddef>
+#include "BitVector.hpp"
+#include "SeekHint.hpp"
+
+namespace ariel
+{
+    using namespace std;
+
+    // Sorted multiset of integers kept in cache-sized sorted blocks.
+    // A top-level index holds the largest value of every block, so an insert or erase
+    // binary searches the index and then only moves data inside a single block.
+    // Every block caches the prime flags of its values, so prime traversal never calls isPrime
+    class ChunkedStorage
+    {
+    private:
+        vector<vector<int>> blocks;
+        vector<int> blockMax; // blockMax[i] == blocks[i].back()
+        vector<BitVector> blockPrimes; // blockPrimes[i].test(j) tells whether blocks[i][j] is prime
+        vector<size_t> primeCounts; // primeCounts[i] == set bits of blockPrimes[i]
+        size_t blockSize;
+        size_t total;
+        size_t primes;
+
+        // A position inside the blocks: blocks[block][offset]
+        struct Position
+        {
+            size_t block;
+            size_t offset;
+        };
+
+        size_t findBlock(int value) const;
+        void splitBlock(size_t block);
+        void mergeWithNext(size_t block);
+
+    public:
+        static constexpr size_t DEFAULT_BLOCK_SIZE = 512;
+
+        explicit ChunkedStorage(size_t blockSize = DEFAULT_BLOCK_SIZE);
+        void insert(int value);
+        // Never allocates: every block reserves room for two full blocks, so merging sparse neighbours fits
+        bool erase(int value) noexcept;
+        size_t eraseAll(int value) noexcept;
+        bool contains(int value) const;
+        size_t count(int value) const;
+        size_t size() const;
+        size_t primeCount() const;
+        size_t blockCount() const;
+        // Order statistics: a neighbour of the hinted rank is one step away, any other rank walks the
+        // block sizes, O(size / blockSize)
+        size_t rank(int value) const;
+        const int &select(size_t rank, SeekHint &hint) const;
+        const int &selectPrime(size_t primeRank, SeekHint &hint) const;
+        vector<int> toVector() const;
+
+    private:
+        Position past() const;
+        void advance(Position &position) const;
+        void retreat(Position &position) const;
+        void seekPrime(Position &position) const;
+        Position locate(size_t rank) const;
+        Position locatePrime(size_t primeRank) const;
+        void addBlock(size_t block, vector<int> values, BitVector flags);
+        void removeBlock(size_t block) noexcept;
+    };
+} // namespace ariel
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef EXPECTED_HPP
+#define EXPECTED_HPP
+
+#include <stdexcept>
+#include <utility>
+
+namespace ariel
+{
+    // Error codes reported by the non-throwing container API
+    enum class ContainerError
+    {
+        NotFound
+    };
+
+    // Wraps an error so it can be told apart from a value when building an Expected
+    template <typename E>
+    struct Unexpected
+    {
+        E error;
+    };
+
+    template <typename E>
+    Unexpected<E> unexpected(E error)
+    {
+        return Unexpected<E>{error};
+    }
+
+    // Minimal std::expected-style result: holds either a value or an error code.
+    // Reporting the error never allocates, only value() on an error throws.
+    template <typename T, typename E = ContainerError>
+    class Expected
+    {
+    private:
+        T val;
+        E err;
+        bool ok;
+
+    public:
+        Expected(T value) : val(std::move(value)), err(), ok(true) {}
+        Expected(Unexpected<E> failure) : val(), err(failure.error), ok(false) {}
+
+        bool has_value() const noexcept { return ok; }
+        explicit operator bool() const noexcept { return ok; }
+
+        const T &value() const
+        {
+            if (!ok)
+            {
+                throw std::runtime_error("Expected has no value");
+            }
+            return val;
+        }
+
+        T value_or(T fallback) const { return ok ? val : fallback; }
+        E error() const noexcept { return err; }
+    };
+} // namespace ariel
+
+#endif
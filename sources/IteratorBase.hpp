@@ -0,0 +1,42 @@
+#ifndef ITERATOR_BASE_HPP
+#define ITERATOR_BASE_HPP
+
+#include <concepts>
+
+namespace ariel
+{
+    // CRTP base of the container iterators.
+    // The derived iterator defines operator== and operator<, the other comparisons are built on top of
+    // them at compile time, so there is no vtable and every call can be inlined.
+    template <typename Derived>
+    class IteratorBase
+    {
+    public:
+        friend bool operator!=(const Derived &lhs, const Derived &rhs) { return !(lhs == rhs); }
+        friend bool operator>(const Derived &lhs, const Derived &rhs) { return rhs < lhs; }
+        friend bool operator<=(const Derived &lhs, const Derived &rhs) { return !(rhs < lhs); }
+        friend bool operator>=(const Derived &lhs, const Derived &rhs) { return !(lhs < rhs); }
+
+    protected:
+        IteratorBase() = default;
+        IteratorBase(const IteratorBase &other) = default;
+        IteratorBase &operator=(const IteratorBase &other) = default;
+        // Not virtual: iterators are never deleted through the base
+        ~IteratorBase() = default;
+    };
+
+    // Interface every container iterator must provide
+    template <typename It>
+    concept MagicalIterator = requires(It it, const It constIt) {
+        { *it } -> std::same_as<int &>;
+        { ++it } -> std::same_as<It &>;
+        { it.begin() } -> std::same_as<It &>;
+        { it.end() } -> std::same_as<It &>;
+        { constIt == constIt } -> std::convertible_to<bool>;
+        { constIt != constIt } -> std::convertible_to<bool>;
+        { constIt < constIt } -> std::convertible_to<bool>;
+        { constIt > constIt } -> std::convertible_to<bool>;
+    };
+} // namespace ariel
+
+#endif
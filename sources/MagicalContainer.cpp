@@ -1,5 +1,11 @@
 #include "MagicalContainer.hpp"
+#include "Primality.hpp"
+#include "RadixSort.hpp"
 #include <algorithm>
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <queue>
 #include <vector>
 #include <stdexcept>
 
@@ -12,6 +18,24 @@ namespace ariel
         // Constructor is simplified: we just initialize 'elements' to an empty vector of integers
         elements = std::vector<int>();
     }
+    //constructor that keeps the elements in the given storage
+    MagicalContainer::MagicalContainer(Storage storage) : layout(storage)
+    {
+        switch (storage)
+        {
+        case Storage::Chunked:
+            chunked = std::make_unique<ChunkedStorage>();
+            break;
+        case Storage::OrderStatistic:
+            tree = std::make_unique<OrderStatisticTree>();
+            break;
+        case Storage::RunLength:
+            runLength = std::make_unique<RunLengthStorage>();
+            break;
+        default:
+            break;
+        }
+    }
     //destructor
     MagicalContainer::~MagicalContainer()
     {
@@ -19,336 +43,926 @@ namespace ariel
     //add element to the container
     bool MagicalContainer::addElement(int newElement)
     {
-        // Insert the new element in the correct place
-        elements.insert(std::upper_bound(elements.begin(), elements.end(), newElement), newElement);
+        if (bufferCapacity > 0)
+        {
+            pending.push_back(newElement);
+            if (pending.size() >= bufferCapacity)
+            {
+                flush();
+            }
+            return true;
+        }
+        if (layout != Storage::Vector)
+        {
+            mutateEngine([newElement](auto &engine) { engine.insert(newElement); });
+            return true;
+        }
+        // Ascending streams append without searching, otherwise insert after any equal copies
+        size_t index = elements.size();
+        if (!elements.empty() && newElement < elements.back())
+        {
+            auto position = std::upper_bound(elements.begin(), elements.end(), newElement);
+            index = static_cast<size_t>(position - elements.begin());
+        }
+        insertAt(index, newElement);
         return true;
     }
-    //remove element from the container
-    bool MagicalContainer::removeElement(int element)
+    //add element to the container, searching from a position hint
+    size_t MagicalContainer::addElement(size_t hint, int newElement)
     {
-        // Find the element in the container
-        auto it = std::find(elements.begin(), elements.end(), element);
-        // If the element was found, remove it
-        if (it != elements.end())
+        syncPending();
+        if (layout != Storage::Vector)
         {
-            // Remove the element from the container
-            elements.erase(it);
-            return true;
+            // The engines search by value, the hint is not needed
+            return mutateEngine([newElement](auto &engine) {
+                engine.insert(newElement);
+                return engine.rank(newElement) + engine.count(newElement) - 1;
+            });
         }
-        else
+        return insertAt(hintedPosition(hint, newElement), newElement);
+    }
+    //insert at 'index' and keep the prime flags, prime positions and dead flags in sync
+    size_t MagicalContainer::insertAt(size_t index, int newElement)
+    {
+        bool prime = isPrime(newElement);
+        if (index == elements.size())
         {
-            throw std::runtime_error("Element not found in container");
+            // Appending shifts nothing: amortized O(1)
+            primeFlags.push_back(prime);
+            if (prime)
+            {
+                primePositions.push_back(index);
+            }
+            if (tombstones())
+            {
+                deadFlags.push_back(false);
+                if (prime)
+                {
+                    deadPrimes.push_back(false);
+                }
+            }
+            elements.push_back(newElement);
+            return index;
+        }
+        primeFlags.insert(index, prime);
+        if (tombstones())
+        {
+            deadFlags.insert(index, false);
         }
+        insertPrimePosition(index, prime);
+        elements.insert(elements.begin() + static_cast<std::ptrdiff_t>(index), newElement);
+        return index;
     }
-    //get the number of elements in the container
-    std::vector<int> MagicalContainer::getElements() const
+    //upper_bound position of 'element', galloping out from 'hint' with doubling steps
+    size_t MagicalContainer::hintedPosition(size_t hint, int element) const
     {
-        return this->elements;
+        size_t count = elements.size();
+        hint = std::min(hint, count);
+        size_t low = hint;
+        size_t high = hint;
+        if (hint < count && elements[hint] <= element)
+        {
+            // The position is after the hint
+            low = hint + 1;
+            size_t step = 1;
+            while (hint + step < count && elements[hint + step] <= element)
+            {
+                low = hint + step + 1;
+                step *= 2;
+            }
+            high = std::min(hint + step, count);
+        }
+        else if (hint > 0 && elements[hint - 1] > element)
+        {
+            // The position is before the hint
+            high = hint - 1;
+            size_t step = 1;
+            while (step < hint && elements[hint - 1 - step] > element)
+            {
+                high = hint - 1 - step;
+                step *= 2;
+            }
+            low = step < hint ? hint - step : 0;
+        }
+        auto first = elements.begin() + static_cast<std::ptrdiff_t>(low);
+        auto last = elements.begin() + static_cast<std::ptrdiff_t>(high);
+        return static_cast<size_t>(std::upper_bound(first, last, element) - elements.begin());
     }
-    //get the number of elements in the container
-    int MagicalContainer::size() const
+    //buffer up to 'capacity' inserts before merging them, 0 turns buffering off
+    void MagicalContainer::setInsertBuffer(size_t capacity)
     {
-        return this->elements.size();
+        bufferCapacity = capacity;
+        if (pending.size() >= capacity)
+        {
+            flush();
+        }
+        pending.reserve(capacity);
     }
 
-    MagicalContainer::AscendingIterator& MagicalContainer::getAscendingIterator()
+    size_t MagicalContainer::insertBuffer() const
     {
-        return this->ascendingIterator;
+        return bufferCapacity;
     }
 
-    MagicalContainer::SideCrossIterator& MagicalContainer::getSideCrossIterator()
+    size_t MagicalContainer::pendingCount() const
     {
-        return this->sideCrossIterator;
+        return pending.size();
+    }
+    //sort the buffered elements and merge them into 'elements' with their prime flags
+    void MagicalContainer::flush()
+    {
+        if (pending.empty())
+        {
+            return;
+        }
+        if (layout != Storage::Vector)
+        {
+            mutateEngine([this](auto &engine) {
+                for (int value : pending)
+                {
+                    engine.insert(value);
+                }
+            });
+            pending.clear();
+            return;
+        }
+        // A handful of values moves less memory inserted one by one than merged with the whole storage
+        if (pending.size() <= SMALL_FLUSH)
+        {
+            for (int value : pending)
+            {
+                auto position = std::upper_bound(elements.begin(), elements.end(), value);
+                insertAt(static_cast<size_t>(position - elements.begin()), value);
+            }
+            pending.clear();
+            return;
+        }
+        size_t oldSize = elements.size();
+        elements.insert(elements.end(), pending.begin(), pending.end());
+        pending.clear();
+        mergeNewElements(oldSize);
+    }
+    //0 erases on removal, a ratio in (0, 1] turns on tombstones and sets when they are compacted
+    void MagicalContainer::setTombstoneThreshold(double maxDeadRatio)
+    {
+        if (maxDeadRatio < 0 || maxDeadRatio > 1)
+        {
+            throw std::invalid_argument("Dead ratio threshold must be between 0 and 1");
+        }
+        if (maxDeadRatio > 0 && layout != Storage::Vector)
+        {
+            throw std::logic_error("Tombstones need the vector storage");
+        }
+        if (maxDeadRatio == 0)
+        {
+            compact();
+            deadFlags.clear();
+            deadPrimes.clear();
+        }
+        else if (!tombstones())
+        {
+            deadFlags.assignZeros(elements.size());
+            deadPrimes.assignZeros(primePositions.size());
+        }
+        this->maxDeadRatio = maxDeadRatio;
+        compactIfOverThreshold();
     }
 
-    MagicalContainer::PrimeIterator& MagicalContainer::getPrimeIterator()
+    double MagicalContainer::tombstoneThreshold() const
     {
-        return this->primeIterator;
+        return maxDeadRatio;
     }
 
-    // AscendingIterator
-    // AscendingIterator constructor
-    MagicalContainer::AscendingIterator::AscendingIterator() : container(nullptr), currElement(nullptr)
+    double MagicalContainer::deadRatio() const
     {
+        return elements.empty() ? 0 : static_cast<double>(deadCount) / static_cast<double>(elements.size());
+    }
+    //mark a live slot dead, the bitmaps are already sized so this only sets bits
+    void MagicalContainer::markDead(size_t index) noexcept
+    {
+        deadFlags.set(index, true);
+        if (primeFlags.test(index))
+        {
+            auto rank = std::lower_bound(primePositions.begin(), primePositions.end(), index) - primePositions.begin();
+            deadPrimes.set(static_cast<size_t>(rank), true);
+        }
+        ++deadCount;
     }
 
-    // AscendingIterator constructor with container parameter
-    MagicalContainer::AscendingIterator::AscendingIterator(MagicalContainer& container)
-            : container(&container)
+    void MagicalContainer::compactIfOverThreshold()
     {
-        if (!container.elements.empty())
+        if (deadRatio() > maxDeadRatio)
         {
-            currElement = container.elements.begin(); // It should start from the smallest element
+            compact();
         }
-        else
+    }
+    //drop every dead slot in one pass, moving each run of live elements down in place. Nothing grows,
+    //so compaction does not allocate and the non-throwing removals can run it
+    void MagicalContainer::compact()
+    {
+        if (deadCount == 0)
         {
-            currElement = container.elements.end(); // If container is empty, currElement is end
+            return;
+        }
+        auto start = std::chrono::steady_clock::now();
+        size_t kept = 0;
+        size_t index = deadFlags.findNextClear(0);
+        while (index < elements.size())
+        {
+            size_t runEnd = deadFlags.findNext(index);
+            std::copy(elements.begin() + static_cast<std::ptrdiff_t>(index),
+                      elements.begin() + static_cast<std::ptrdiff_t>(runEnd),
+                      elements.begin() + static_cast<std::ptrdiff_t>(kept));
+            for (; index < runEnd; ++index)
+            {
+                primeFlags.set(kept++, primeFlags.test(index));
+            }
+            index = deadFlags.findNextClear(runEnd);
         }
+        elements.resize(kept);
+        primeFlags.erase(kept, primeFlags.size());
+        stats.slotsReclaimed += deadCount;
+        deadFlags.assignZeros(kept);
+        deadCount = 0;
+        rebuildPrimePositions();
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        ++stats.compactions;
+        stats.lastMs = elapsed.count();
+        stats.totalMs += elapsed.count();
     }
-    // AscendingIterator copy constructor
 
-    MagicalContainer::AscendingIterator::AscendingIterator(const AscendingIterator& other)
-            : container(other.container), currElement(other.currElement)
+    MagicalContainer::CompactionStats MagicalContainer::compactionStats() const
     {
+        return stats;
     }
-    // AscendingIterator destructor
-    MagicalContainer::AscendingIterator::~AscendingIterator()
+    //add a batch of elements to the container
+    bool MagicalContainer::addElements(std::span<const int> newElements)
     {
+        return addElements(newElements.begin(), newElements.end());
     }
+    //sort the elements appended after 'oldSize' and merge them with the sorted prefix
+    void MagicalContainer::mergeNewElements(size_t oldSize)
+    {
+        auto middle = elements.begin() + static_cast<std::ptrdiff_t>(oldSize);
+        // Only the new batch is sorted, the prefix is already in order
+        sortIntegers(std::span<int>(elements).subspan(oldSize));
+
+        // Replay the merge on the prime and dead flags, only the new values are tested
+        BitVector mergedFlags;
+        BitVector mergedDead;
+        mergedFlags.reserve(elements.size());
+        bool tracking = tombstones();
+        auto takeOld = [&](size_t oldIndex) {
+            mergedFlags.push_back(primeFlags.test(oldIndex));
+            if (tracking)
+            {
+                mergedDead.push_back(deadFlags.test(oldIndex));
+            }
+        };
+        size_t oldIndex = 0;
+        for (auto newIt = middle; newIt != elements.end(); ++newIt)
+        {
+            while (oldIndex < oldSize && !(*newIt < elements[oldIndex]))
+            {
+                takeOld(oldIndex++);
+            }
+            mergedFlags.push_back(isPrime(*newIt));
+            if (tracking)
+            {
+                mergedDead.push_back(false);
+            }
+        }
+        while (oldIndex < oldSize)
+        {
+            takeOld(oldIndex++);
+        }
+        primeFlags.swap(mergedFlags);
+        if (tracking)
+        {
+            deadFlags.swap(mergedDead);
+        }
+        rebuildPrimePositions();
 
-    int& MagicalContainer::AscendingIterator::operator*()
+        // inplace_merge is stable, so equal values keep the upper_bound order of addElement
+        std::inplace_merge(elements.begin(), middle, elements.end());
+    }
+    //parallel bulk insert: sort partitions of the batch on the pool, testing their primes in the same task
+    bool MagicalContainer::addElements(std::span<const int> newElements, const ParallelPolicy &policy)
     {
-        if (currElement != container->elements.end())
+        if (policy.sequential(newElements.size()) || layout != Storage::Vector)
         {
-            return *currElement;
+            return addElements(newElements);
         }
-        else
+        ThreadPool &pool = policy.threadPool();
+        size_t grain = std::max<size_t>(policy.grain, 1);
+        size_t partCount = std::clamp<size_t>(newElements.size() / grain, 1, pool.size() * 2);
+
+        std::vector<int> batch(newElements.begin(), newElements.end());
+        std::vector<uint8_t> batchFlags(batch.size());
+        std::vector<size_t> runStarts;
+        for (size_t part = 0; part <= partCount; ++part)
         {
-            throw std::runtime_error("Iterator out of bounds");
+            runStarts.push_back(batch.size() * part / partCount);
         }
+        TaskGroup group(pool);
+        for (size_t part = 0; part < partCount; ++part)
+        {
+            group.run([&, part] {
+                sortIntegers(std::span<int>(batch).subspan(runStarts[part], runStarts[part + 1] - runStarts[part]));
+                for (size_t i = runStarts[part]; i < runStarts[part + 1]; ++i)
+                {
+                    batchFlags[i] = isPrime(batch[i]) ? 1 : 0;
+                }
+            });
+        }
+        group.wait();
+        mergeSortedRuns(batch, batchFlags, runStarts, policy);
+        return true;
     }
+    //k-way merge of the sorted batch runs with 'elements'. Splitters sampled from the runs cut the
+    //output into value ranges whose offsets are known up front, so every range is merged by its own task
+    void MagicalContainer::mergeSortedRuns(const std::vector<int> &batch, const std::vector<uint8_t> &batchFlags,
+                                           const std::vector<size_t> &runStarts, const ParallelPolicy &policy)
+    {
+        // Runs below batchRuns are slices of the batch, the last run is the current 'elements'
+        size_t batchRuns = runStarts.size() - 1;
+        std::vector<std::span<const int>> runs;
+        for (size_t run = 0; run < batchRuns; ++run)
+        {
+            runs.push_back(std::span<const int>(batch).subspan(runStarts[run], runStarts[run + 1] - runStarts[run]));
+        }
+        runs.emplace_back(elements);
+        size_t total = batch.size() + elements.size();
+        ThreadPool &pool = policy.threadPool();
+        size_t segments = std::clamp<size_t>(total / std::max<size_t>(policy.grain, 1), 1, pool.size() * 4);
+
+        std::vector<int> samples;
+        for (std::span<const int> run : runs)
+        {
+            for (size_t i = 0; i < segments && !run.empty(); ++i)
+            {
+                samples.push_back(run[run.size() * i / segments]);
+            }
+        }
+        std::sort(samples.begin(), samples.end());
+
+        // bounds[segment][run]: where the segment starts inside the run
+        std::vector<std::vector<size_t>> bounds(segments + 1, std::vector<size_t>(runs.size(), 0));
+        std::vector<size_t> offsets(segments + 1, 0);
+        for (size_t segment = 1; segment <= segments; ++segment)
+        {
+            for (size_t run = 0; run < runs.size(); ++run)
+            {
+                if (segment == segments)
+                {
+                    bounds[segment][run] = runs[run].size();
+                }
+                else
+                {
+                    int splitter = samples[samples.size() * segment / segments];
+                    auto position = std::lower_bound(runs[run].begin(), runs[run].end(), splitter);
+                    bounds[segment][run] = static_cast<size_t>(position - runs[run].begin());
+                }
+                offsets[segment] += bounds[segment][run];
+            }
+        }
 
-    MagicalContainer::AscendingIterator& MagicalContainer::AscendingIterator::operator++()
+        // Bit 0 of a merged flag is the prime flag, bit 1 the dead flag
+        constexpr uint8_t PRIME = 1;
+        constexpr uint8_t DEAD = 2;
+        bool tracking = tombstones();
+        std::vector<int> merged(total);
+        std::vector<uint8_t> mergedFlags(total);
+        TaskGroup group(pool);
+        for (size_t segment = 0; segment < segments; ++segment)
+        {
+            group.run([&, segment] {
+                using Head = std::pair<int, size_t>;
+                std::priority_queue<Head, std::vector<Head>, std::greater<>> heads;
+                std::vector<size_t> cursor = bounds[segment];
+                const std::vector<size_t> &stop = bounds[segment + 1];
+                for (size_t run = 0; run < runs.size(); ++run)
+                {
+                    if (cursor[run] < stop[run])
+                    {
+                        heads.emplace(runs[run][cursor[run]], run);
+                    }
+                }
+                for (size_t out = offsets[segment]; !heads.empty(); ++out)
+                {
+                    size_t run = heads.top().second;
+                    heads.pop();
+                    size_t index = cursor[run]++;
+                    merged[out] = runs[run][index];
+                    if (run < batchRuns)
+                    {
+                        mergedFlags[out] = batchFlags[runStarts[run] + index] != 0 ? PRIME : 0;
+                    }
+                    else
+                    {
+                        bool dead = tracking && deadFlags.test(index);
+                        mergedFlags[out] = static_cast<uint8_t>((primeFlags.test(index) ? PRIME : 0) | (dead ? DEAD : 0));
+                    }
+                    if (cursor[run] < stop[run])
+                    {
+                        heads.emplace(runs[run][cursor[run]], run);
+                    }
+                }
+            });
+        }
+        group.wait();
+
+        BitVector flags;
+        BitVector dead;
+        flags.reserve(total);
+        for (uint8_t flag : mergedFlags)
+        {
+            flags.push_back((flag & PRIME) != 0);
+            if (tracking)
+            {
+                dead.push_back((flag & DEAD) != 0);
+            }
+        }
+        elements.swap(merged);
+        primeFlags.swap(flags);
+        if (tracking)
+        {
+            deadFlags.swap(dead);
+        }
+        rebuildPrimePositions();
+    }
+    //remove element from the container
+    bool MagicalContainer::removeElement(int element)
     {
-        // If the iterator is not at the end of the container, move to the next element
-        if (currElement != container->elements.end())
+        if (!tryRemove(element))
         {
-            ++currElement;
+            throw std::runtime_error("Element not found in container");
         }
-        else
+        return true;
+    }
+    //remove every copy of element from the container with a single range erase
+    size_t MagicalContainer::removeAll(int element)
+    {
+        Expected<size_t> removed = tryRemoveAll(element);
+        if (!removed)
         {
-            throw std::runtime_error("Iterator out of bounds");
+            throw std::runtime_error("Element not found in container");
         }
-        return *this;
+        return removed.value();
     }
-
-    //return the begining of the container
-    MagicalContainer::AscendingIterator& MagicalContainer::AscendingIterator::begin() {
-        currElement = container->elements.begin(); // or wherever the beginning is for this iterator
-        return *this;
+    //remove element from the container, false if it is not there
+    bool MagicalContainer::tryRemove(int element) noexcept
+    {
+        // A buffered copy leaves the buffer without a merge
+        auto buffered = std::find(pending.begin(), pending.end(), element);
+        if (buffered != pending.end())
+        {
+            *buffered = pending.back();
+            pending.pop_back();
+            return true;
+        }
+        if (layout != Storage::Vector)
+        {
+            return mutateEngine([element](auto &engine) { return engine.erase(element); });
+        }
+        if (maxDeadRatio > 0)
+        {
+            // Tombstone mode: mark the first live copy dead instead of erasing it
+            auto range = std::equal_range(elements.begin(), elements.end(), element);
+            size_t live = nextLive(static_cast<size_t>(range.first - elements.begin()));
+            if (live >= static_cast<size_t>(range.second - elements.begin()))
+            {
+                return false;
+            }
+            markDead(live);
+            compactIfOverThreshold();
+            return true;
+        }
+        // The elements are sorted, so binary search for the first copy
+        auto it = std::lower_bound(elements.begin(), elements.end(), element);
+        if (it == elements.end() || *it != element)
+        {
+            return false;
+        }
+        // Remove the element from the container
+        auto index = static_cast<size_t>(it - elements.begin());
+        primeFlags.erase(index);
+        erasePrimePositions(index, index + 1);
+        elements.erase(it);
+        return true;
     }
-    //return the end of the container
-    MagicalContainer::AscendingIterator& MagicalContainer::AscendingIterator::end() {
-        currElement = container->elements.end(); // or wherever the end is for this iterator
-        return *this;
+    //remove every copy of element, reports NotFound instead of throwing
+    Expected<size_t> MagicalContainer::tryRemoveAll(int element) noexcept
+    {
+        auto kept = std::remove(pending.begin(), pending.end(), element);
+        auto buffered = static_cast<size_t>(pending.end() - kept);
+        pending.erase(kept, pending.end());
+        if (layout != Storage::Vector)
+        {
+            size_t removed = mutateEngine([element](auto &engine) { return engine.eraseAll(element); });
+            if (removed + buffered == 0)
+            {
+                return unexpected(ContainerError::NotFound);
+            }
+            return removed + buffered;
+        }
+        auto range = std::equal_range(elements.begin(), elements.end(), element);
+        if (maxDeadRatio > 0)
+        {
+            // Tombstone mode: mark every live copy dead, then compact at most once
+            size_t marked = 0;
+            auto last = static_cast<size_t>(range.second - elements.begin());
+            for (size_t index = nextLive(static_cast<size_t>(range.first - elements.begin())); index < last;
+                 index = nextLive(index + 1))
+            {
+                markDead(index);
+                ++marked;
+            }
+            compactIfOverThreshold();
+            if (marked + buffered == 0)
+            {
+                return unexpected(ContainerError::NotFound);
+            }
+            return marked + buffered;
+        }
+        if (range.first == range.second)
+        {
+            if (buffered > 0)
+            {
+                return buffered;
+            }
+            return unexpected(ContainerError::NotFound);
+        }
+        auto first = static_cast<size_t>(range.first - elements.begin());
+        auto removed = static_cast<size_t>(range.second - range.first);
+        primeFlags.erase(first, first + removed);
+        erasePrimePositions(first, first + removed);
+        elements.erase(range.first, range.second);
+        return removed + buffered;
     }
-    //operator= for AscendingIterator
-    MagicalContainer::AscendingIterator &MagicalContainer::AscendingIterator::operator=(const AscendingIterator &other)
+    //shift the prime positions after a new element at 'index', and record it if it is prime
+    void MagicalContainer::insertPrimePosition(size_t index, bool prime)
     {
-        // Check for self-assignment
-        if (this != &other)
+        auto shifted = std::lower_bound(primePositions.begin(), primePositions.end(), index);
+        for (auto it = shifted; it != primePositions.end(); ++it)
         {
-            // Check that the iterators are from the same container
-            if (container != other.container) {
-                throw std::runtime_error("Assigning iterators from different containers is not allowed!");
+            ++*it;
+        }
+        if (prime)
+        {
+            if (tombstones())
+            {
+                deadPrimes.insert(static_cast<size_t>(shifted - primePositions.begin()), false);
             }
-            container = other.container;
-            currElement = other.currElement;
+            primePositions.insert(shifted, index);
         }
-        return *this;
     }
-    //noexcept operator= for AscendingIterator
-    MagicalContainer::AscendingIterator& MagicalContainer::AscendingIterator::operator=(AscendingIterator&& other) noexcept
+    //drop the prime positions in [first, last) and shift the ones after them back
+    void MagicalContainer::erasePrimePositions(size_t first, size_t last)
     {
-        if (this != &other)
+        auto from = std::lower_bound(primePositions.begin(), primePositions.end(), first);
+        auto to = std::lower_bound(from, primePositions.end(), last);
+        for (auto it = to; it != primePositions.end(); ++it)
         {
-            other.container = nullptr;
-            other.currElement = container->elements.end();
+            *it -= last - first;
         }
-        return *this;
+        primePositions.erase(from, to);
     }
-    MagicalContainer::AscendingIterator::AscendingIterator(AscendingIterator&& other) noexcept
-            : container(other.container), currElement(other.currElement)
+    //rebuild the prime positions, and the dead flags of the primes, from the per-element flags in one pass
+    void MagicalContainer::rebuildPrimePositions()
     {
-        other.container = nullptr;
-        other.currElement = container->elements.end();
+        primePositions.clear();
+        deadPrimes.clear();
+        for (size_t index = primeFlags.findNext(0); index < primeFlags.size(); index = primeFlags.findNext(index + 1))
+        {
+            primePositions.push_back(index);
+            if (tombstones())
+            {
+                deadPrimes.push_back(deadFlags.test(index));
+            }
+        }
+    }
+    //index of the first prime element at or after 'from', scans 64 prime flags per step
+    size_t MagicalContainer::nextPrimeIndex(size_t from) const
+    {
+        requireVector();
+        requireMerged();
+        size_t index = primeFlags.findNext(from);
+        while (deadCount > 0 && index < elements.size() && deadFlags.test(index))
+        {
+            index = primeFlags.findNext(index + 1);
+        }
+        return index;
+    }
+    //copy the next prime elements found from index 'from' into 'out', 'from' moves past the last one copied
+    size_t MagicalContainer::scanPrimes(size_t &from, std::span<int> out) const
+    {
+        size_t copied = 0;
+        size_t index = nextPrimeIndex(from);
+        while (copied < out.size() && index < elements.size())
+        {
+            out[copied++] = elements[index];
+            index = nextPrimeIndex(index + 1);
+        }
+        from = index;
+        return copied;
+    }
+    //number of elements smaller than 'value'
+    size_t MagicalContainer::rank(int value) const
+    {
+        // Buffered elements and dead slots are counted in place, a rank query does not force a merge
+        size_t sorted = 0;
+        if (layout != Storage::Vector)
+        {
+            sorted = withEngine([value](const auto &engine) { return engine.rank(value); });
+        }
+        else
+        {
+            sorted = liveRank(static_cast<size_t>(std::lower_bound(elements.begin(), elements.end(), value) - elements.begin()));
+        }
+        auto buffered = std::count_if(pending.begin(), pending.end(), [value](int element) { return element < value; });
+        return sorted + static_cast<size_t>(buffered);
+    }
+    //the element at position 'rank' in ascending order
+    int MagicalContainer::select(size_t rank) const
+    {
+        if (rank >= static_cast<size_t>(size()))
+        {
+            throw std::out_of_range("Rank out of range");
+        }
+        if (pending.empty() && layout != Storage::Vector)
+        {
+            SeekHint hint;
+            return withEngine([rank, &hint](const auto &engine) { return engine.select(rank, hint); });
+        }
+        if (pending.empty())
+        {
+            return elements[liveSlot(rank)];
+        }
+        // Without merging the buffer: the answer is the largest value with at most 'rank' elements below it
+        long long low = std::numeric_limits<int>::min();
+        long long high = std::numeric_limits<int>::max();
+        while (low < high)
+        {
+            long long middle = low + (high - low + 1) / 2;
+            if (this->rank(static_cast<int>(middle)) <= rank)
+            {
+                low = middle;
+            }
+            else
+            {
+                high = middle - 1;
+            }
+        }
+        return static_cast<int>(low);
+    }
+    //get the number of elements in the container
+    std::vector<int> MagicalContainer::getElements() const
+    {
+        if (layout == Storage::Vector && deadCount == 0 && pending.empty())
+        {
+            return this->elements;
+        }
+        std::vector<int> live;
+        if (layout != Storage::Vector)
+        {
+            live = withEngine([](const auto &engine) { return engine.toVector(); });
+        }
+        live.reserve(elements.size() - deadCount + live.size() + pending.size());
+        for (size_t index = nextLive(0); index < elements.size(); index = nextLive(index + 1))
+        {
+            live.push_back(elements[index]);
+        }
+        // The buffered elements are merged into the copy, the container itself is left as it is
+        auto middle = static_cast<std::ptrdiff_t>(live.size());
+        live.insert(live.end(), pending.begin(), pending.end());
+        std::sort(live.begin() + middle, live.end());
+        std::inplace_merge(live.begin(), live.begin() + middle, live.end());
+        return live;
+    }
+    //get the number of elements in the container
+    int MagicalContainer::size() const
+    {
+        // Buffered elements count without merging them
+        return slotCount() - deadCount + pending.size();
+    }
+
+    MagicalContainer::Storage MagicalContainer::storage() const
+    {
+        return layout;
     }
 
-    //bool operators for AscendingIterator
+    //ascending read through the buffer merge, the dead slots or the engine
+    int &MagicalContainer::readAscending(size_t index, Finger &finger)
+    {
+        syncPending();
+        index = nextLive(index);
+        if (index >= slotCount())
+        {
+            throw std::runtime_error("Iterator out of bounds");
+        }
+        return iteratorAt(index, finger);
+    }
 
-    bool MagicalContainer::AscendingIterator::operator==(const AscendingIterator& other) const
+    //slot after the live element at or after 'index', throws at the end
+    size_t MagicalContainer::nextAscending(size_t index)
     {
-        return currElement == other.currElement;
+        syncPending();
+        index = nextLive(index);
+        if (index >= slotCount())
+        {
+            throw std::runtime_error("Iterator out of bounds");
+        }
+        return nextLive(index + 1);
     }
 
-    bool MagicalContainer::AscendingIterator::operator!=(const AscendingIterator& other) const
+    //prime read through the buffer merge, the dead primes or the engine
+    int &MagicalContainer::readPrime(size_t rank, Finger &finger)
     {
-        return !(*this == other);
+        syncPending();
+        rank = nextLivePrime(rank);
+        if (rank >= primeSlotCount())
+        {
+            throw std::out_of_range("Attempting to dereference end iterator");
+        }
+        return iteratorPrimeAt(rank, finger);
     }
 
-    bool MagicalContainer::AscendingIterator::operator<(const AscendingIterator& other) const
+    //the next prime is the next live entry of the index
+    size_t MagicalContainer::nextPrime(size_t rank)
     {
-        return currElement < other.currElement;
+        syncPending();
+        rank = nextLivePrime(rank);
+        if (rank >= primeSlotCount())
+        {
+            throw std::runtime_error("Iterator out of bounds");
+        }
+        return nextLivePrime(rank + 1);
     }
 
-    bool MagicalContainer::AscendingIterator::operator>(const AscendingIterator& other) const
+    MagicalContainer::AscendingIterator& MagicalContainer::getAscendingIterator()
     {
-        // Return true if the current iterator has moved further than the other iterator.
-        return currElement > other.currElement;
+        return this->ascendingIterator;
     }
 
+    MagicalContainer::SideCrossIterator& MagicalContainer::getSideCrossIterator()
+    {
+        return this->sideCrossIterator;
+    }
 
-    // SideCrossIterator
-    MagicalContainer::SideCrossIterator::SideCrossIterator()
-            : Iterator(), container(nullptr), currStartElement(nullptr),
-              currEndElement(nullptr), fromStart(true), progress(0)
+    MagicalContainer::PrimeIterator& MagicalContainer::getPrimeIterator()
     {
+        return this->primeIterator;
     }
 
-    MagicalContainer::SideCrossIterator::SideCrossIterator(MagicalContainer& container)
-            : Iterator(), container(&container), currStartElement(nullptr),
-              currEndElement(nullptr), fromStart(true), progress(0)
+    // AscendingIterator
+    // AscendingIterator constructor
+    MagicalContainer::AscendingIterator::AscendingIterator() : IteratorBase(), container(nullptr), currIndex(0)
     {
-        // If the container is not empty, initialize the iterator to point to the first and last elements
-        if (!container.elements.empty())
-        {
-            currStartElement = container.elements.begin();
-            currEndElement = container.elements.end() - 1;
-        }
     }
 
-    MagicalContainer::SideCrossIterator::SideCrossIterator(const SideCrossIterator& other)
-            : Iterator(), container(other.container), currStartElement(other.currStartElement),
-              currEndElement(other.currEndElement), fromStart(other.fromStart),
-              progress(other.progress)
+    // AscendingIterator constructor with container parameter, starts from the smallest element
+    MagicalContainer::AscendingIterator::AscendingIterator(MagicalContainer& container)
+            : IteratorBase(), container(&container), currIndex(0)
     {
     }
+    // AscendingIterator copy constructor
 
-    MagicalContainer::SideCrossIterator::~SideCrossIterator()
+    MagicalContainer::AscendingIterator::AscendingIterator(const AscendingIterator& other)
+            : IteratorBase(), container(other.container), currIndex(other.currIndex)
+    {
+    }
+    // AscendingIterator destructor
+    MagicalContainer::AscendingIterator::~AscendingIterator()
     {
-        // Destructor
     }
 
-    MagicalContainer::SideCrossIterator& MagicalContainer::SideCrossIterator::operator=(const SideCrossIterator& other)
+    //operator= for AscendingIterator
+    MagicalContainer::AscendingIterator &MagicalContainer::AscendingIterator::operator=(const AscendingIterator &other)
     {
+        // Check for self-assignment
         if (this != &other)
         {
-            // Check if the iterators belong to different containers
+            // Check that the iterators are from the same container
             if (container != other.container) {
                 throw std::runtime_error("Assigning iterators from different containers is not allowed!");
             }
-
-            // Copy the values from the other iterator
             container = other.container;
-            currStartElement = other.currStartElement;
-            currEndElement = other.currEndElement;
-            fromStart = other.fromStart;
-            progress = other.progress;
-        }
-        else
-        {
-            throw std::runtime_error("Assigning iterator to itself is not allowed!");
+            currIndex = other.currIndex;
+            // The finger caches this iterator's own reads, possibly in another engine: start without one
+            finger = Finger{};
         }
         return *this;
     }
-
-    bool MagicalContainer::SideCrossIterator::operator==(const SideCrossIterator& other) const
+    //noexcept operator= for AscendingIterator
+    MagicalContainer::AscendingIterator& MagicalContainer::AscendingIterator::operator=(AscendingIterator&& other) noexcept
     {
-        // Check if the container and progress of the iterators are equal
-        return container == other.container && progress == other.progress;
+        if (this != &other)
+        {
+            container = other.container;
+            currIndex = other.currIndex;
+            // The finger caches this iterator's own reads, possibly in another engine: start without one
+            finger = Finger{};
+            other.container = nullptr;
+            other.currIndex = 0;
+        }
+        return *this;
     }
-
-    bool MagicalContainer::SideCrossIterator::operator!=(const SideCrossIterator& other) const
+    MagicalContainer::AscendingIterator::AscendingIterator(AscendingIterator&& other) noexcept
+            : IteratorBase(), container(other.container), currIndex(other.currIndex)
     {
-        // Inverse of the equality operator
-        return !(*this == other);
+        other.container = nullptr;
+        other.currIndex = 0;
     }
 
-    bool MagicalContainer::SideCrossIterator::operator<(const SideCrossIterator& other) const
+    //copy the next elements in one block copy
+    size_t MagicalContainer::AscendingIterator::fill(std::span<int> out)
     {
-        // Check if the iterators belong to different containers
-        if (container != other.container)
+        container->syncPending();
+        if (container->layout != Storage::Vector)
         {
-            throw std::runtime_error("Comparing iterators from different containers is not allowed!");
-        }
-
-        if (fromStart && !other.fromStart)
-        {
-            return true; // This iterator is at the start, while the other is at the end
+            // Engines step from the finger, one element at a time
+            size_t count = 0;
+            for (size_t end = container->slotCount(); count < out.size() && currIndex < end; ++currIndex)
+            {
+                out[count++] = container->elementAt(currIndex, finger);
+            }
+            return count;
         }
-        else if (!fromStart && other.fromStart)
+        const vector<int> &elements = container->elements;
+        if (container->deadCount == 0)
         {
-            return false; // This iterator is at the end, while the other is at the start
+            size_t remaining = elements.size() - std::min(currIndex, elements.size());
+            size_t count = std::min(out.size(), remaining);
+            std::copy_n(elements.begin() + static_cast<std::ptrdiff_t>(currIndex), count, out.begin());
+            currIndex += count;
+            return count;
         }
-        else
+        // Block copy every run of live slots between two dead ones
+        size_t count = 0;
+        size_t index = position();
+        while (count < out.size() && index < elements.size())
         {
-            return progress < other.progress; // Compare the progress of the iterators
+            size_t runEnd = std::min(container->deadFlags.findNext(index), index + out.size() - count);
+            std::copy(elements.begin() + static_cast<std::ptrdiff_t>(index),
+                      elements.begin() + static_cast<std::ptrdiff_t>(runEnd), out.begin() + static_cast<std::ptrdiff_t>(count));
+            count += runEnd - index;
+            index = container->nextLive(runEnd);
         }
+        currIndex = index;
+        return count;
     }
 
-    bool MagicalContainer::SideCrossIterator::operator>(const SideCrossIterator& other) const
+    // SideCrossIterator
+    MagicalContainer::SideCrossIterator::SideCrossIterator()
+            : IteratorBase(), container(nullptr), progress(0)
     {
-        // Check if the iterators belong to different containers
-        if (container != other.container)
-        {
-            throw std::runtime_error("Comparing iterators from different containers is not allowed!");
-        }
-
-        return other < *this; // Inverse of the < operator
     }
 
-    int& MagicalContainer::SideCrossIterator::operator*() {
-        // Dereference operator
-        if (fromStart) {
-            if (currStartElement <= currEndElement) {
-                return *currStartElement;
-            }
-        } else {
-            if (currEndElement >= currStartElement) {
-                return *currEndElement;
-            }
-        }
-        throw std::runtime_error("Iterator out of bounds");
+    MagicalContainer::SideCrossIterator::SideCrossIterator(MagicalContainer& container)
+            : IteratorBase(), container(&container), progress(0)
+    {
     }
 
-    MagicalContainer::SideCrossIterator& MagicalContainer::SideCrossIterator::operator++() {
-        // Pre-increment operator
-        if (fromStart) {
-            if (currStartElement <= currEndElement) {
-                ++currStartElement;
-                ++progress;
-                fromStart = false;
-            } else {
-                throw std::runtime_error("Iterator out of bounds");
-            }
-        } else {
-            if (currEndElement >= currStartElement) {
-                --currEndElement;
-                ++progress;
-                fromStart = true;
-            } else {
-                throw std::runtime_error("Iterator out of bounds");
-            }
-        }
-        return *this;
+    MagicalContainer::SideCrossIterator::SideCrossIterator(const SideCrossIterator& other)
+            : IteratorBase(), container(other.container), progress(other.progress)
+    {
     }
 
-    MagicalContainer::SideCrossIterator& MagicalContainer::SideCrossIterator::begin() {
-        // Set the iterator to the beginning state
-        currStartElement = container->elements.begin();
-        currEndElement = container->elements.end() - 1;
-        fromStart = true;
-        progress = 0;
-        return *this;
+    MagicalContainer::SideCrossIterator::~SideCrossIterator()
+    {
+        // Destructor
     }
 
-    MagicalContainer::SideCrossIterator& MagicalContainer::SideCrossIterator::end() {
-        // Set the iterator to the end state
-        currStartElement = container->elements.end();
-        currEndElement = container->elements.begin() - 1;
-        fromStart = false;
-        progress = container->elements.size();
+    MagicalContainer::SideCrossIterator& MagicalContainer::SideCrossIterator::operator=(const SideCrossIterator& other)
+    {
+        if (this != &other)
+        {
+            // Check if the iterators belong to different containers
+            if (container != other.container) {
+                throw std::runtime_error("Assigning iterators from different containers is not allowed!");
+            }
+
+            // Copy the values from the other iterator
+            container = other.container;
+            progress = other.progress;
+            // The finger caches this iterator's own reads, possibly in another engine: start without one
+            finger = Finger{};
+        }
+        else
+        {
+            throw std::runtime_error("Assigning iterator to itself is not allowed!");
+        }
         return *this;
     }
 
     MagicalContainer::SideCrossIterator::SideCrossIterator(SideCrossIterator&& other) noexcept
-            : Iterator(), container(other.container), currStartElement(other.currStartElement),
-              currEndElement(other.currEndElement), fromStart(other.fromStart),
-              progress(other.progress)
+            : IteratorBase(), container(other.container), progress(other.progress)
     {
         // Move constructor
-        other.currStartElement = container->elements.end();
-        other.currEndElement = container->elements.end();
+        other.container = nullptr;
+        other.progress = 0;
     }
 
     MagicalContainer::SideCrossIterator& MagicalContainer::SideCrossIterator::operator=(SideCrossIterator&& other) noexcept
@@ -357,40 +971,44 @@ namespace ariel
         {
             // Move the values from the other iterator
             container = other.container;
-            fromStart = other.fromStart;
             progress = other.progress;
-            other.currStartElement = container->elements.end();
-            other.currEndElement = container->elements.end();
+            // The finger caches this iterator's own reads, possibly in another engine: start without one
+            finger = Finger{};
+            other.container = nullptr;
+            other.progress = 0;
         }
         return *this;
     }
 
+    //interleave the next elements from both ends
+    size_t MagicalContainer::SideCrossIterator::fill(std::span<int> out)
+    {
+        container->syncDense();
+        size_t count = 0;
+        while (count < out.size() && progress < container->slotCount())
+        {
+            out[count++] = container->elementAt(currIndex(), finger, progress % 2 == 1);
+            ++progress;
+        }
+        return count;
+    }
+
     // PrimeIterator
+    // The iterator holds its rank among the primes, primePositions maps it to an index in 'elements'
     MagicalContainer::PrimeIterator::PrimeIterator()
-            : Iterator(), container(nullptr), currElement()
+            : IteratorBase(), container(nullptr), currPrime(0)
     {
         // Default constructor
     }
 
     MagicalContainer::PrimeIterator::PrimeIterator(MagicalContainer& container)
-            : Iterator(), container(&container), currElement(container.elements.end())
+            : IteratorBase(), container(&container), currPrime(0)
     {
-        // Constructor that takes a container
-        if (container.elements.empty())
-        {
-            return;
-        }
-
-        // Initialize the iterator to the first prime element in the container
-        currElement = container.elements.begin();
-        while (currElement != container.elements.end() && !isPrime(*currElement))
-        {
-            ++currElement;
-        }
+        // Constructor that takes a container, starts at the first prime element
     }
 
     MagicalContainer::PrimeIterator::PrimeIterator(const PrimeIterator& other)
-            : Iterator(), container(other.container), currElement(other.currElement)
+            : IteratorBase(), container(other.container), currPrime(other.currPrime)
     {
         // Copy constructor
     }
@@ -410,7 +1028,9 @@ namespace ariel
             }
             // Copy the values from the other iterator
             container = other.container;
-            currElement = other.currElement;
+            currPrime = other.currPrime;
+            // The finger caches this iterator's own reads, possibly in another engine: start without one
+            finger = Finger{};
         }
         else{
             throw std::runtime_error("Cannot assign to itself");
@@ -418,80 +1038,12 @@ namespace ariel
         return *this;
     }
 
-    bool MagicalContainer::PrimeIterator::operator==(const PrimeIterator& other) const
-    {
-        // Check if the current elements of the iterators are equal
-        return currElement == other.currElement;
-    }
-
-    bool MagicalContainer::PrimeIterator::operator!=(const PrimeIterator& other) const
-    {
-        // Inverse of the equality operator
-        return !(*this == other);
-    }
-
-    bool MagicalContainer::PrimeIterator::operator<(const PrimeIterator& other) const
-    {
-        // Compare the current elements of the iterators
-        return currElement < other.currElement;
-    }
-
-    bool MagicalContainer::PrimeIterator::operator>(const PrimeIterator& other) const
-    {
-        // Compare the current elements of the iterators
-        return currElement > other.currElement;
-    }
-
-    int& MagicalContainer::PrimeIterator::operator*()
-    {
-        // Dereference operator
-        if (currElement != container->elements.end())
-        {
-            return *currElement;
-        }
-        throw std::out_of_range("Attempting to dereference end iterator");
-    }
-
-    MagicalContainer::PrimeIterator& MagicalContainer::PrimeIterator::operator++()
-    {
-        // Pre-increment operator
-        if (currElement != container->elements.end())
-        {
-            ++currElement;
-            // Find the next prime element in the container
-            while (currElement != container->elements.end() && !isPrime(*currElement))
-            {
-                ++currElement;
-            }
-        }
-        else
-        {
-            throw std::runtime_error("Iterator out of bounds");
-        }
-        return *this;
-    }
-
-    MagicalContainer::PrimeIterator& MagicalContainer::PrimeIterator::begin() {
-        // Set the iterator to the beginning state
-        currElement = container->elements.begin();
-        if (currElement != container->elements.end() && !isPrime(*currElement)) {
-            // Find the first prime element in the container
-            ++(*this);
-        }
-        return *this;
-    }
-
-    MagicalContainer::PrimeIterator& MagicalContainer::PrimeIterator::end() {
-        // Set the iterator to the end state
-        currElement = container->elements.end();
-        return *this;
-    }
-
     MagicalContainer::PrimeIterator::PrimeIterator(PrimeIterator&& other) noexcept
-            : Iterator(), container(other.container), currElement(other.currElement)
+            : IteratorBase(), container(other.container), currPrime(other.currPrime)
     {
         // Move constructor
-        other.currElement = other.container->elements.end();
+        other.container = nullptr;
+        other.currPrime = 0;
     }
 
     MagicalContainer::PrimeIterator& MagicalContainer::PrimeIterator::operator=(PrimeIterator&& other) noexcept
@@ -500,23 +1052,47 @@ namespace ariel
         {
             // Move the values from the other iterator
             container = other.container;
-            currElement = other.currElement;
-            other.currElement = other.container->elements.end();
+            currPrime = other.currPrime;
+            // The finger caches this iterator's own reads, possibly in another engine: start without one
+            finger = Finger{};
+            other.container = nullptr;
+            other.currPrime = 0;
         }
 
         return *this;
     }
 
-    bool MagicalContainer::PrimeIterator::isPrime(int num){
-        // Function to check if a number is prime
-        if(num <= 1){
-            return false;
+    //gather the next primes through the prime position index
+    size_t MagicalContainer::PrimeIterator::fill(std::span<int> out)
+    {
+        container->syncPending();
+        if (container->layout != Storage::Vector)
+        {
+            size_t count = 0;
+            for (size_t end = container->primeSlotCount(); count < out.size() && currPrime < end; ++currPrime)
+            {
+                out[count++] = container->primeAt(currPrime, finger);
+            }
+            return count;
         }
-        for(int i = 2; i < num; i++){
-            if(num % i == 0){
-                return false;
+        const vector<size_t> &positions = container->primePositions;
+        if (container->deadCount == 0)
+        {
+            size_t count = std::min(out.size(), positions.size() - std::min(currPrime, positions.size()));
+            for (size_t i = 0; i < count; ++i)
+            {
+                out[i] = container->elements[positions[currPrime + i]];
             }
+            currPrime += count;
+            return count;
         }
-        return true;
+        size_t count = 0;
+        size_t rank = position();
+        for (; count < out.size() && rank < positions.size(); rank = container->nextLivePrime(rank + 1))
+        {
+            out[count++] = container->elements[positions[rank]];
+        }
+        currPrime = rank;
+        return count;
     }
 }
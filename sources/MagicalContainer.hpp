@@ -1,9 +1,24 @@
 #ifndef MAGICAL_CONTAINER_HPP
 #define MAGICAL_CONTAINER_HPP
 
+#include <algorithm>
 #include <iostream>
+#include <memory>
 #include <vector>
 #include <cmath>
+#include <span>
+#include <iterator>
+#include <ranges>
+#include <compare>
+#include <stdexcept>
+#include "Expected.hpp"
+#include "BitVector.hpp"
+#include "ChunkedStorage.hpp"
+#include "OrderStatisticTree.hpp"
+#include "RunLengthStorage.hpp"
+#include "SeekHint.hpp"
+#include "IteratorBase.hpp"
+#include "ThreadPool.hpp"
 
 namespace ariel
 {
@@ -13,124 +28,728 @@ namespace ariel
     class MagicalContainer
     {
     private:
+        // Index in 'elements' of the step-th element of the cross order:
+        // even steps take elements from the start, odd steps from the end
+        static size_t sideCrossIndex(size_t step, size_t count)
+        {
+            size_t offset = step / 2;
+            return step % 2 == 0 ? offset : count - 1 - offset;
+        }
 
-        class Iterator {
-        private:
-            int *currElement;
-
-        public:
-            Iterator() : currElement(nullptr) {};
-            Iterator(const Iterator &other) = delete;
-            virtual ~Iterator() = default;
-            virtual int &operator*() = 0;
-            virtual Iterator &operator++() = 0;
-            Iterator &operator=(const Iterator &other) = delete;
-            Iterator &operator=(Iterator &&other) = delete;
-            Iterator(Iterator &&other) noexcept = delete;
-            virtual Iterator &begin() = 0;
-            virtual Iterator &end() = 0;
-
-            void setCurrentElement(int *element) {
-                currElement = element;
-            }
+        // Where the engine reads of one iterator last landed, from the start and from the end, and the
+        // engine version they were taken at, so a mutation drops them
+        struct Finger
+        {
+            SeekHint front;
+            SeekHint back;
+            uint64_t version = 0;
         };
 
-
     public:
+        // Where the sorted elements live. Vector keeps them contiguous in 'elements'. Chunked keeps them
+        // in a ChunkedStorage, sorted blocks with cached prime flags, so an insert or removal only moves
+        // one block; 'elements' stays empty and the iterators, views and rank/select go through the engine.
+        // OrderStatistic keeps them in an OrderStatisticTree: inserts, removals, rank and select take
+        // O(log n), and so does every iterator step. RunLength keeps one (value, count) run per distinct
+        // value: adding or removing a copy of a stored value only changes its counter, and the iterators
+        // walk the runs copy by copy without expanding them. Tombstones and the accessors that hand out
+        // contiguous storage need Vector
+        enum class Storage
+        {
+            Vector,
+            Chunked,
+            OrderStatistic,
+            RunLength
+        };
+
         // Iterator class for ascending order
-        class AscendingIterator : public Iterator
+        // Iterators hold positions rather than vector iterators, so they stay valid when 'elements'
+        // reallocates and see elements that are added after they were created.
+        class AscendingIterator : public IteratorBase<AscendingIterator>
         {
         private:
             MagicalContainer *container;
-            vector<int>::iterator currElement;
+            size_t currIndex; // Index of the current element in 'elements', or its rank in the engine
+            mutable Finger finger;
+
+            // The slot the iterator reads, past any dead slots left by tombstone removals
+            size_t position() const
+            {
+                return container == nullptr ? currIndex : container->nextLive(currIndex);
+            }
 
         public:
             AscendingIterator();
             AscendingIterator(MagicalContainer &container);
             AscendingIterator(const AscendingIterator &other);
-            ~AscendingIterator() override;
+            ~AscendingIterator();
             AscendingIterator &operator=(const AscendingIterator &other);
             AscendingIterator &operator=(AscendingIterator &&other) noexcept; // Move assignment operator
-            bool operator==(const AscendingIterator &other) const;
-            bool operator!=(const AscendingIterator &other) const;
-            bool operator<(const AscendingIterator &other) const;
-            bool operator>(const AscendingIterator &other) const;
-            int &operator*() override;
-            AscendingIterator &operator++() override;
-            AscendingIterator& begin() override;
-            AscendingIterator& end() override;
             AscendingIterator(AscendingIterator &&other) noexcept; // Move constructor
+            // Copy the next elements into 'out' and move past them, returns how many were copied
+            size_t fill(span<int> out);
+
+            // Hot paths are defined here so they inline into the caller's loop
+            bool operator==(const AscendingIterator &other) const
+            {
+                if (container != other.container)
+                {
+                    return false;
+                }
+                return container == nullptr || container->deadCount == 0 ? currIndex == other.currIndex
+                                                                          : position() == other.position();
+            }
+
+            bool operator<(const AscendingIterator &other) const
+            {
+                if (container != other.container)
+                {
+                    throw std::runtime_error("Comparing iterators from different containers is not allowed!");
+                }
+                return position() < other.position();
+            }
+
+            int &operator*() const
+            {
+                if (container->plain())
+                {
+                    if (currIndex >= container->elements.size())
+                    {
+                        throw std::runtime_error("Iterator out of bounds");
+                    }
+                    return container->elements[currIndex];
+                }
+                return container->readAscending(currIndex, finger);
+            }
+
+            AscendingIterator &operator++()
+            {
+                // Stepping only needs a bound, so every storage takes this path while it is settled
+                if (container->settled())
+                {
+                    if (currIndex >= container->slotCount())
+                    {
+                        throw std::runtime_error("Iterator out of bounds");
+                    }
+                    ++currIndex;
+                    return *this;
+                }
+                currIndex = container->nextAscending(currIndex);
+                return *this;
+            }
+
+            AscendingIterator &begin()
+            {
+                // Slot 0 rather than the first live slot, so a later compaction cannot move the start
+                currIndex = 0;
+                return *this;
+            }
+
+            AscendingIterator &end()
+            {
+                container->syncPending();
+                currIndex = container->slotCount();
+                return *this;
+            }
+
+            // Random access: jumps, distances and indexing are O(1) over the sorted storage. With dead
+            // slots they count live elements only, which takes a popcount over the dead bitmap
+            using iterator_category = std::random_access_iterator_tag;
+            using value_type = int;
+            using difference_type = std::ptrdiff_t;
+            using pointer = int *;
+            using reference = int &;
+
+            AscendingIterator &operator--()
+            {
+                return *this -= 1;
+            }
+
+            AscendingIterator operator++(int)
+            {
+                AscendingIterator previous(*this);
+                ++*this;
+                return previous;
+            }
+
+            AscendingIterator operator--(int)
+            {
+                AscendingIterator previous(*this);
+                --*this;
+                return previous;
+            }
+
+            AscendingIterator &operator+=(difference_type steps)
+            {
+                // The target may be the end position but never past it
+                container->syncPending();
+                difference_type target = static_cast<difference_type>(container->liveRank(currIndex)) + steps;
+                if (target < 0 || static_cast<size_t>(target) > container->slotCount() - container->deadCount)
+                {
+                    throw std::runtime_error("Iterator out of bounds");
+                }
+                currIndex = container->liveSlot(static_cast<size_t>(target));
+                return *this;
+            }
+
+            AscendingIterator &operator-=(difference_type steps)
+            {
+                return *this += -steps;
+            }
+
+            AscendingIterator operator+(difference_type steps) const
+            {
+                AscendingIterator moved(*this);
+                return moved += steps;
+            }
+
+            friend AscendingIterator operator+(difference_type steps, const AscendingIterator &it)
+            {
+                return it + steps;
+            }
+
+            AscendingIterator operator-(difference_type steps) const
+            {
+                AscendingIterator moved(*this);
+                return moved -= steps;
+            }
+
+            // Number of steps from 'other' to this iterator
+            difference_type operator-(const AscendingIterator &other) const
+            {
+                if (container != other.container)
+                {
+                    throw std::runtime_error("Comparing iterators from different containers is not allowed!");
+                }
+                container->syncPending();
+                return static_cast<difference_type>(container->liveRank(currIndex)) -
+                       static_cast<difference_type>(container->liveRank(other.currIndex));
+            }
+
+            int &operator[](difference_type offset) const
+            {
+                return *(*this + offset);
+            }
+
+            std::strong_ordering operator<=>(const AscendingIterator &other) const
+            {
+                if (container != other.container)
+                {
+                    throw std::runtime_error("Comparing iterators from different containers is not allowed!");
+                }
+                return position() <=> other.position();
+            }
         };
 
-        class SideCrossIterator : public Iterator
+        class SideCrossIterator : public IteratorBase<SideCrossIterator>
         {
         private:
             MagicalContainer *container;
-            vector<int>::iterator currStartElement;
-            vector<int>::iterator currEndElement;
-            bool fromStart; // Flag to track whether to take an element from the start or end
-            size_t progress;
+            size_t progress; // Number of elements already visited in cross order
+            mutable Finger finger;
+
+            size_t currIndex() const
+            {
+                return sideCrossIndex(progress, container->slotCount());
+            }
 
         public:
             // Constructor
             SideCrossIterator();
             SideCrossIterator(MagicalContainer &container);
             SideCrossIterator(const SideCrossIterator &other);
-            ~SideCrossIterator() override;
+            ~SideCrossIterator();
             SideCrossIterator &operator=(const SideCrossIterator &other);
-            bool operator==(const SideCrossIterator &other) const;
-            bool operator!=(const SideCrossIterator &other) const;
-            bool operator<(const SideCrossIterator &other) const;
-            bool operator>(const SideCrossIterator &other) const;
-            int &operator*() override;
-            SideCrossIterator &operator++() override;
-            SideCrossIterator &begin() override;
-            SideCrossIterator &end() override;
             SideCrossIterator(SideCrossIterator &&other) noexcept;
             SideCrossIterator &operator=(SideCrossIterator &&other) noexcept;
+            size_t fill(span<int> out);
+
+            bool operator==(const SideCrossIterator &other) const
+            {
+                // Check if the container and progress of the iterators are equal
+                return container == other.container && progress == other.progress;
+            }
+
+            bool operator<(const SideCrossIterator &other) const
+            {
+                // Check if the iterators belong to different containers
+                if (container != other.container)
+                {
+                    throw std::runtime_error("Comparing iterators from different containers is not allowed!");
+                }
+                return progress < other.progress;
+            }
+
+            int &operator*() const
+            {
+                container->syncDense();
+                if (progress >= container->slotCount())
+                {
+                    throw std::runtime_error("Iterator out of bounds");
+                }
+                return container->iteratorAt(currIndex(), finger, progress % 2 == 1);
+            }
+
+            SideCrossIterator &operator++()
+            {
+                container->syncDense();
+                if (progress >= container->slotCount())
+                {
+                    throw std::runtime_error("Iterator out of bounds");
+                }
+                ++progress;
+                return *this;
+            }
+
+            SideCrossIterator &begin()
+            {
+                // Set the iterator to the beginning state
+                progress = 0;
+                return *this;
+            }
+
+            SideCrossIterator &end()
+            {
+                // Set the iterator to the end state
+                container->syncDense();
+                progress = container->slotCount();
+                return *this;
+            }
+
+            // Random access: the k-th element of the cross order is found in closed form
+            using iterator_category = std::random_access_iterator_tag;
+            using value_type = int;
+            using difference_type = std::ptrdiff_t;
+            using pointer = int *;
+            using reference = int &;
+
+            SideCrossIterator &operator--()
+            {
+                return *this -= 1;
+            }
+
+            SideCrossIterator operator++(int)
+            {
+                SideCrossIterator previous(*this);
+                ++*this;
+                return previous;
+            }
+
+            SideCrossIterator operator--(int)
+            {
+                SideCrossIterator previous(*this);
+                --*this;
+                return previous;
+            }
+
+            SideCrossIterator &operator+=(difference_type steps)
+            {
+                container->syncDense();
+                difference_type target = static_cast<difference_type>(progress) + steps;
+                if (target < 0 || static_cast<size_t>(target) > container->slotCount())
+                {
+                    throw std::runtime_error("Iterator out of bounds");
+                }
+                progress = static_cast<size_t>(target);
+                return *this;
+            }
+
+            SideCrossIterator &operator-=(difference_type steps)
+            {
+                return *this += -steps;
+            }
+
+            SideCrossIterator operator+(difference_type steps) const
+            {
+                SideCrossIterator moved(*this);
+                return moved += steps;
+            }
+
+            friend SideCrossIterator operator+(difference_type steps, const SideCrossIterator &it)
+            {
+                return it + steps;
+            }
+
+            SideCrossIterator operator-(difference_type steps) const
+            {
+                SideCrossIterator moved(*this);
+                return moved -= steps;
+            }
+
+            // Number of steps from 'other' to this iterator
+            difference_type operator-(const SideCrossIterator &other) const
+            {
+                if (container != other.container)
+                {
+                    throw std::runtime_error("Comparing iterators from different containers is not allowed!");
+                }
+                return static_cast<difference_type>(progress) - static_cast<difference_type>(other.progress);
+            }
+
+            int &operator[](difference_type offset) const
+            {
+                return *(*this + offset);
+            }
+
+            std::strong_ordering operator<=>(const SideCrossIterator &other) const
+            {
+                if (container != other.container)
+                {
+                    throw std::runtime_error("Comparing iterators from different containers is not allowed!");
+                }
+                return progress <=> other.progress;
+            }
         };
 
 
-        class PrimeIterator : public Iterator
+        class PrimeIterator : public IteratorBase<PrimeIterator>
         {
         private:
             MagicalContainer *container;
-            vector<int>::iterator currElement;
-            bool fromStart; // Flag to track whether to take an element from the start or end
-            size_t progress;
-            static bool isPrime(int num);
+            size_t currPrime; // Rank of the current element among the primes
+            mutable Finger finger;
+
+            // The prime rank the iterator reads, past any dead primes
+            size_t position() const
+            {
+                return container == nullptr ? currPrime : container->nextLivePrime(currPrime);
+            }
 
         public:
             // Constructor
             PrimeIterator();
             PrimeIterator(MagicalContainer &container);
             PrimeIterator(const PrimeIterator &other);
-            ~PrimeIterator() override;
+            ~PrimeIterator();
             PrimeIterator &operator=(const PrimeIterator &other);
-            bool operator==(const PrimeIterator &other) const;
-            bool operator!=(const PrimeIterator &other) const;
-            bool operator<(const PrimeIterator &other) const;
-            bool operator>(const PrimeIterator &other) const;
-            int &operator*() override;
-            PrimeIterator &operator++() override;
-            PrimeIterator &begin() override; // Changed return type to PrimeIterator
-            PrimeIterator &end() override; // Changed return type to PrimeIterator
             PrimeIterator(PrimeIterator &&other) noexcept;
             PrimeIterator &operator=(PrimeIterator &&other) noexcept;
-            void setToEnd();
+            size_t fill(span<int> out);
+
+            bool operator==(const PrimeIterator &other) const
+            {
+                // Check if the iterators point at the same prime of the same container
+                if (container != other.container)
+                {
+                    return false;
+                }
+                return container == nullptr || container->deadCount == 0 ? currPrime == other.currPrime
+                                                                          : position() == other.position();
+            }
+
+            bool operator<(const PrimeIterator &other) const
+            {
+                if (container != other.container)
+                {
+                    throw std::runtime_error("Comparing iterators from different containers is not allowed!");
+                }
+                // Compare the positions of the iterators among the primes
+                return position() < other.position();
+            }
+
+            int &operator*() const
+            {
+                if (container->plain())
+                {
+                    if (currPrime >= container->primePositions.size())
+                    {
+                        throw std::out_of_range("Attempting to dereference end iterator");
+                    }
+                    return container->elements[container->primePositions[currPrime]];
+                }
+                return container->readPrime(currPrime, finger);
+            }
+
+            PrimeIterator &operator++()
+            {
+                if (container->settled())
+                {
+                    if (currPrime >= container->primeSlotCount())
+                    {
+                        throw std::runtime_error("Iterator out of bounds");
+                    }
+                    ++currPrime;
+                    return *this;
+                }
+                currPrime = container->nextPrime(currPrime);
+                return *this;
+            }
+
+            PrimeIterator &begin()
+            {
+                currPrime = 0;
+                return *this;
+            }
+
+            PrimeIterator &end()
+            {
+                container->syncPending();
+                currPrime = container->primeSlotCount();
+                return *this;
+            }
+        };
+
+    private:
+        // Element access for each order by position, used by the views below
+        struct AscendingOrder
+        {
+            static const int &at(const MagicalContainer &container, size_t index, Finger &finger)
+            {
+                return container.elementAt(index, finger);
+            }
+            static size_t count(const MagicalContainer &container)
+            {
+                container.requireDense();
+                return container.slotCount();
+            }
+        };
+
+        struct SideCrossOrder
+        {
+            static const int &at(const MagicalContainer &container, size_t index, Finger &finger)
+            {
+                return container.elementAt(sideCrossIndex(index, container.slotCount()), finger, index % 2 == 1);
+            }
+            static size_t count(const MagicalContainer &container)
+            {
+                container.requireDense();
+                return container.slotCount();
+            }
+        };
+
+        struct PrimeOrder
+        {
+            static const int &at(const MagicalContainer &container, size_t index, Finger &finger)
+            {
+                return container.primeAt(index, finger);
+            }
+            static size_t count(const MagicalContainer &container)
+            {
+                container.requireDense();
+                return container.primeSlotCount();
+            }
+        };
+
+    public:
+        // Read-only std::ranges::view over one iteration order.
+        // Its iterator is a container pointer and a position, end() is a sentinel that checks the
+        // live element count, so elements added after the view was created are still visited.
+        template <typename Order>
+        class OrderView : public std::ranges::view_interface<OrderView<Order>>
+        {
+        public:
+            struct Sentinel
+            {
+            };
+
+            class Iterator
+            {
+            private:
+                const MagicalContainer *container = nullptr;
+                size_t position = 0;
+                mutable Finger finger;
+
+            public:
+                using value_type = int;
+                using difference_type = std::ptrdiff_t;
+                using iterator_concept = std::forward_iterator_tag;
+
+                Iterator() = default;
+                Iterator(const MagicalContainer *container, size_t position) : container(container), position(position) {}
+
+                const int &operator*() const { return Order::at(*container, position, finger); }
+
+                Iterator &operator++()
+                {
+                    ++position;
+                    return *this;
+                }
+
+                Iterator operator++(int)
+                {
+                    Iterator previous = *this;
+                    ++position;
+                    return previous;
+                }
+
+                bool operator==(const Iterator &other) const
+                {
+                    return container == other.container && position == other.position;
+                }
+
+                friend bool operator==(const Iterator &it, Sentinel)
+                {
+                    return it.position >= Order::count(*it.container);
+                }
+            };
+
+            // Positions [first, last) of the order that can be halved for parallel traversal.
+            // Every order addresses its elements by position (primes by rank in primePositions), so
+            // split() is O(1) and both halves hold the same number of elements.
+            class Spliterator
+            {
+            private:
+                const MagicalContainer *container;
+                size_t first;
+                size_t last;
+
+            public:
+                Spliterator(const MagicalContainer *container, size_t first, size_t last)
+                        : container(container), first(first), last(last) {}
+
+                size_t size() const { return last - first; }
+
+                // Hand out the first half of the remaining positions and keep the second half
+                Spliterator split()
+                {
+                    size_t middle = first + size() / 2;
+                    Spliterator prefix(container, first, middle);
+                    first = middle;
+                    return prefix;
+                }
+
+                template <typename Fn>
+                void forEachRemaining(Fn &&fn)
+                {
+                    Finger finger;
+                    for (; first < last; ++first)
+                    {
+                        fn(Order::at(*container, first, finger));
+                    }
+                }
+            };
+
+            OrderView() = default;
+            explicit OrderView(const MagicalContainer *container) : container(container) {}
+
+            Iterator begin() const { return Iterator(container, 0); }
+            Sentinel end() const { return Sentinel{}; }
+            size_t size() const { return Order::count(*container); }
+            Spliterator spliterator() const { return Spliterator(container, 0, size()); }
+
+        private:
+            const MagicalContainer *container = nullptr;
         };
 
+        using AscendingView = OrderView<AscendingOrder>;
+        using SideCrossView = OrderView<SideCrossOrder>;
+        using PrimeView = OrderView<PrimeOrder>;
+
+        AscendingView ascending() const { return AscendingView(this); }
+        SideCrossView sideCross() const { return SideCrossView(this); }
+        PrimeView primes() const { return PrimeView(this); }
+
         vector<int> elements;
         AscendingIterator ascendingIterator;
         SideCrossIterator sideCrossIterator;
         PrimeIterator primeIterator;
 
         MagicalContainer();  // Magic container constructor
+        explicit MagicalContainer(Storage storage);
         ~MagicalContainer(); // Magic container destructor
         bool addElement(int element);
+        // Insert next to 'hint', the index where the caller expects the value to land. A right hint is
+        // checked in O(1), a wrong one costs O(log distance). Returns the index the value now has, so
+        // index + 1 is the hint for the next value of an ascending stream
+        size_t addElement(size_t hint, int element);
+        // LSM-style write buffering: with a capacity above zero addElement appends to an unsorted
+        // buffer, which is sorted and merged into 'elements' when it fills up, on flush(), or when an
+        // iterator reads. size(), rank(), select(), getElements() and the removals handle buffered
+        // elements in place, see elementsView() for the other const reads. 0, the default, inserts in place
+        void setInsertBuffer(size_t capacity);
+        size_t insertBuffer() const;
+        size_t pendingCount() const;
+        // Merge the buffered elements now
+        void flush();
+        // Tombstone deletion: with a threshold above zero a removal only marks its slot dead, and the
+        // ascending and prime iterators, rank, select and the inserts work around dead slots through
+        // bitmaps. The dead slots are dropped in one pass once they exceed 'maxDeadRatio' of all slots,
+        // on compact(), or before a read that needs dense storage (side cross, views, elementsView).
+        // Compaction moves the live elements down like the erases it replaces, so iterators created
+        // before it may point at a different element afterwards. 0, the default, erases at once.
+        // Only the vector storage has slots to mark, the other storages throw std::logic_error
+        void setTombstoneThreshold(double maxDeadRatio);
+        double tombstoneThreshold() const;
+        // Share of the stored slots that are dead
+        double deadRatio() const;
+        void compact();
+        struct CompactionStats
+        {
+            size_t compactions = 0;
+            size_t slotsReclaimed = 0;
+            double lastMs = 0;
+            double totalMs = 0;
+        };
+        CompactionStats compactionStats() const;
+        // Bulk insert: append the batch, sort it once and merge it into 'elements' in linear time
+        template <typename InputIt>
+        bool addElements(InputIt first, InputIt last)
+        {
+            if (layout != Storage::Vector)
+            {
+                mutateEngine([&](auto &engine) {
+                    for (; first != last; ++first)
+                    {
+                        engine.insert(*first);
+                    }
+                });
+                return true;
+            }
+            size_t oldSize = elements.size();
+            elements.insert(elements.end(), first, last);
+            mergeNewElements(oldSize);
+            return true;
+        }
+        bool addElements(span<const int> newElements);
+        // Parallel bulk insert for very large batches: partitions are sorted on the policy's pool and
+        // k-way merged with the existing elements, small batches fall back to the sequential path
+        bool addElements(span<const int> newElements, const ParallelPolicy &policy);
         bool removeElement(int element);
+        size_t removeAll(int element);
+        // Non-throwing removal for workloads where misses are common
+        bool tryRemove(int element) noexcept;
+        Expected<size_t> tryRemoveAll(int element) noexcept;
         vector<int> getElements() const;
+        // Read-only access to the sorted elements without a copy, valid until the next mutation.
+        // Const reads never merge the insert buffer or compact, so any number of threads may read a
+        // container that no thread is writing. Instead, the const accessors that hand out storage (these,
+        // the views and the parallel algorithms) throw std::logic_error while inserts are buffered or
+        // dead slots remain: call flush() and compact() once the writes are done. Only the vector
+        // storage is contiguous, with any other storage these throw std::logic_error as well
+        span<const int> elementsView() const
+        {
+            requireVector();
+            requireDense();
+            return elements;
+        }
+        // Sorted indices into elementsView() of the prime elements, straight from the cached prime index
+        span<const size_t> primePositionsView() const
+        {
+            requireVector();
+            requireDense();
+            return primePositions;
+        }
+        vector<int>::const_iterator begin() const
+        {
+            requireVector();
+            requireDense();
+            return elements.cbegin();
+        }
+        vector<int>::const_iterator end() const
+        {
+            requireVector();
+            requireDense();
+            return elements.cend();
+        }
+        // Order statistics: number of elements smaller than 'value', and the element at a rank
+        size_t rank(int value) const;
+        int select(size_t rank) const;
+        // Bitset-scan prime traversal over positions in 'elements', throws while inserts are buffered
+        // and with any storage but Vector
+        size_t nextPrimeIndex(size_t from) const;
+        size_t scanPrimes(size_t &from, span<int> out) const;
         int size() const;
+        Storage storage() const;
         AscendingIterator &getAscendingIterator();
         SideCrossIterator &getSideCrossIterator();
         PrimeIterator &getPrimeIterator();
@@ -140,7 +759,235 @@ namespace ariel
         MagicalContainer(MagicalContainer &&other) noexcept = delete;
         MagicalContainer &operator=(MagicalContainer &&other) noexcept = delete;
 
+    private:
+        Storage layout = Storage::Vector;
+        // The engine of the non-vector storages, only the one named by 'layout' is set
+        unique_ptr<ChunkedStorage> chunked;
+        unique_ptr<OrderStatisticTree> tree;
+        unique_ptr<RunLengthStorage> runLength;
+        // Bumped by every engine mutation, so the fingers taken before it are dropped
+        uint64_t engineVersion = 0;
+
+        template <typename Fn>
+        decltype(auto) withEngine(Fn &&fn) const
+        {
+            switch (layout)
+            {
+            case Storage::OrderStatistic:
+                return fn(static_cast<const OrderStatisticTree &>(*tree));
+            case Storage::RunLength:
+                return fn(static_cast<const RunLengthStorage &>(*runLength));
+            default:
+                return fn(static_cast<const ChunkedStorage &>(*chunked));
+            }
+        }
+
+        template <typename Fn>
+        decltype(auto) mutateEngine(Fn &&fn)
+        {
+            ++engineVersion;
+            switch (layout)
+            {
+            case Storage::OrderStatistic:
+                return fn(*tree);
+            case Storage::RunLength:
+                return fn(*runLength);
+            default:
+                return fn(*chunked);
+            }
+        }
+
+        void requireVector() const
+        {
+            if (layout != Storage::Vector)
+            {
+                throw std::logic_error("Contiguous access needs the vector storage");
+            }
+        }
+
+        // Slots the ascending iterator can address: every slot of 'elements', or the engine's size
+        size_t slotCount() const
+        {
+            return layout == Storage::Vector ? elements.size() : withEngine([](const auto &engine) { return engine.size(); });
+        }
+
+        size_t primeSlotCount() const
+        {
+            return layout == Storage::Vector ? primePositions.size()
+                                             : withEngine([](const auto &engine) { return engine.primeCount(); });
+        }
+
+        SeekHint &hintOf(Finger &finger, bool fromBack) const
+        {
+            if (finger.version != engineVersion)
+            {
+                finger = Finger{};
+                finger.version = engineVersion;
+            }
+            return fromBack ? finger.back : finger.front;
+        }
+
+        // The element in slot 'index', an engine finds it by rank stepping from the finger
+        const int &elementAt(size_t index, Finger &finger, bool fromBack = false) const
+        {
+            if (layout == Storage::Vector)
+            {
+                return elements[index];
+            }
+            SeekHint &hint = hintOf(finger, fromBack);
+            return withEngine([&](const auto &engine) -> const int & { return engine.select(index, hint); });
+        }
+
+        const int &primeAt(size_t rank, Finger &finger) const
+        {
+            if (layout == Storage::Vector)
+            {
+                return elements[primePositions[rank]];
+            }
+            SeekHint &hint = hintOf(finger, false);
+            return withEngine([&](const auto &engine) -> const int & { return engine.selectPrime(rank, hint); });
+        }
+
+        // The iterators hand out int& as they always have. The engines only expose const values, and
+        // writing through the reference breaks the order in any storage, so this cast adds nothing new
+        int &iteratorAt(size_t index, Finger &finger, bool fromBack = false)
+        {
+            return const_cast<int &>(elementAt(index, finger, fromBack));
+        }
+
+        int &iteratorPrimeAt(size_t rank, Finger &finger)
+        {
+            return const_cast<int &>(primeAt(rank, finger));
+        }
+
+        // primeFlags[i] tells whether elements[i] is prime, kept in sync by every mutation
+        BitVector primeFlags;
+        // Sorted indices of the prime elements, gives the prime iterator O(1) steps
+        vector<size_t> primePositions;
+        // Elements added through the insert buffer and not merged yet
+        vector<int> pending;
+        size_t bufferCapacity = 0;
+        // Buffers up to this size are flushed with single inserts instead of a full merge
+        static constexpr size_t SMALL_FLUSH = 128;
+
+        // The iterators and the other non-const read paths merge the buffer first
+        void syncPending()
+        {
+            if (!pending.empty())
+            {
+                flush();
+            }
+        }
+
+        // Const read paths only check, so concurrent readers never write
+        void requireMerged() const
+        {
+            if (!pending.empty())
+            {
+                throw std::logic_error("Buffered inserts are not merged, call flush() first");
+            }
+        }
+
+        // deadFlags[i] is set when elements[i] was removed in tombstone mode, and deadPrimes[r] when the
+        // prime of rank r was. Both stay sized while tombstones are on, so a removal never allocates
+        BitVector deadFlags;
+        BitVector deadPrimes;
+        size_t deadCount = 0;
+        double maxDeadRatio = 0;
+        CompactionStats stats;
+
+        // Non-const read paths that address elements by dense position call this instead. The guard
+        // stays inline so a container without dead slots never calls out to compact()
+        void syncDense()
+        {
+            syncPending();
+            if (deadCount > 0)
+            {
+                compact();
+            }
+        }
+
+        void requireDense() const
+        {
+            requireMerged();
+            if (deadCount > 0)
+            {
+                throw std::logic_error("Dead slots are not compacted, call compact() first");
+            }
+        }
+
+        // Nothing buffered and no dead slots: iterator positions are plain ranks and stepping is a bound check
+        bool settled() const
+        {
+            return pending.empty() && deadCount == 0;
+        }
+
+        // A settled vector storage: the iterators index 'elements' and 'primePositions' directly and
+        // skip the buffer, tombstone and engine paths
+        bool plain() const
+        {
+            return layout == Storage::Vector && settled();
+        }
+
+        // The iterators' paths through buffered inserts, dead slots or an engine, kept out of line
+        int &readAscending(size_t index, Finger &finger);
+        size_t nextAscending(size_t index);
+        int &readPrime(size_t rank, Finger &finger);
+        size_t nextPrime(size_t rank);
+
+        bool tombstones() const
+        {
+            return maxDeadRatio > 0;
+        }
+
+        // First live slot at or after 'index'
+        size_t nextLive(size_t index) const
+        {
+            return deadCount == 0 ? index : deadFlags.findNextClear(index);
+        }
+
+        // First prime rank at or after 'rank' whose slot is live
+        size_t nextLivePrime(size_t rank) const
+        {
+            return deadCount == 0 ? rank : deadPrimes.findNextClear(rank);
+        }
+
+        // Live elements before slot 'index', and the slot of the live element with a given rank
+        size_t liveRank(size_t index) const
+        {
+            return deadCount == 0 ? index : std::min(index, elements.size()) - deadFlags.countSet(index);
+        }
+
+        size_t liveSlot(size_t rank) const
+        {
+            return deadCount == 0 ? rank : deadFlags.findNthClear(rank);
+        }
+
+        void markDead(size_t index) noexcept;
+        void compactIfOverThreshold();
+
+        size_t insertAt(size_t index, int element);
+        size_t hintedPosition(size_t hint, int element) const;
+        void mergeNewElements(size_t oldSize);
+        void mergeSortedRuns(const vector<int> &batch, const vector<uint8_t> &batchFlags,
+                             const vector<size_t> &runStarts, const ParallelPolicy &policy);
+        void insertPrimePosition(size_t index, bool prime);
+        void erasePrimePositions(size_t first, size_t last);
+        void rebuildPrimePositions();
     };
+
+    static_assert(MagicalIterator<MagicalContainer::AscendingIterator>);
+    static_assert(MagicalIterator<MagicalContainer::SideCrossIterator>);
+    static_assert(MagicalIterator<MagicalContainer::PrimeIterator>);
+    static_assert(std::random_access_iterator<MagicalContainer::AscendingIterator>);
+    static_assert(std::random_access_iterator<MagicalContainer::SideCrossIterator>);
+    static_assert(std::ranges::view<MagicalContainer::AscendingView>);
+    static_assert(std::ranges::forward_range<MagicalContainer::SideCrossView>);
+    static_assert(std::ranges::sized_range<MagicalContainer::PrimeView>);
 } // namespace ariel
 
+// The views only point into the container, their iterators outlive the view object
+template <typename Order>
+inline constexpr bool std::ranges::enable_borrowed_range<ariel::MagicalContainer::OrderView<Order>> = true;
+
 #endif
@@ -0,0 +1,253 @@
+#include "OrderStatisticTree.hpp"
+#include "Primality.hpp"
+
+namespace ariel
+{
+    OrderStatisticTree::Node::Node(int value, uint32_t priority, bool prime)
+            : value(value), priority(priority), prime(prime), size(1), primes(prime ? 1 : 0)
+    {
+    }
+
+    OrderStatisticTree::OrderStatisticTree() : seed(0x9E3779B9U)
+    {
+    }
+
+    //xorshift32, the treap only needs cheap well-spread priorities
+    uint32_t OrderStatisticTree::nextPriority()
+    {
+        seed ^= seed << 13U;
+        seed ^= seed >> 17U;
+        seed ^= seed << 5U;
+        return seed;
+    }
+
+    size_t OrderStatisticTree::sizeOf(const unique_ptr<Node> &node)
+    {
+        return node ? node->size : 0;
+    }
+
+    size_t OrderStatisticTree::primesOf(const unique_ptr<Node> &node)
+    {
+        return node ? node->primes : 0;
+    }
+
+    void OrderStatisticTree::update(Node &node)
+    {
+        node.size = 1 + sizeOf(node.left) + sizeOf(node.right);
+        node.primes = (node.prime ? 1 : 0) + primesOf(node.left) + primesOf(node.right);
+    }
+
+    //split into values below 'value' (or not above it when keepEqual) and the rest
+    pair<unique_ptr<OrderStatisticTree::Node>, unique_ptr<OrderStatisticTree::Node>>
+    OrderStatisticTree::split(unique_ptr<Node> node, int value, bool keepEqual)
+    {
+        if (!node)
+        {
+            return {nullptr, nullptr};
+        }
+        bool goesLeft = keepEqual ? node->value <= value : node->value < value;
+        if (goesLeft)
+        {
+            auto parts = split(std::move(node->right), value, keepEqual);
+            node->right = std::move(parts.first);
+            update(*node);
+            return {std::move(node), std::move(parts.second)};
+        }
+        auto parts = split(std::move(node->left), value, keepEqual);
+        node->left = std::move(parts.second);
+        update(*node);
+        return {std::move(parts.first), std::move(node)};
+    }
+
+    //join two treaps where every value of 'left' is not above any value of 'right'
+    unique_ptr<OrderStatisticTree::Node> OrderStatisticTree::merge(unique_ptr<Node> left, unique_ptr<Node> right)
+    {
+        if (!left)
+        {
+            return right;
+        }
+        if (!right)
+        {
+            return left;
+        }
+        if (left->priority > right->priority)
+        {
+            left->right = merge(std::move(left->right), std::move(right));
+            update(*left);
+            return left;
+        }
+        right->left = merge(std::move(left), std::move(right->left));
+        update(*right);
+        return right;
+    }
+
+    //add an element after every equal copy
+    void OrderStatisticTree::insert(int value)
+    {
+        auto parts = split(std::move(root), value, true);
+        auto node = std::make_unique<Node>(value, nextPriority(), isPrime(value));
+        root = merge(merge(std::move(parts.first), std::move(node)), std::move(parts.second));
+    }
+
+    //remove one copy of 'value', false when it is not stored
+    bool OrderStatisticTree::erase(int value) noexcept
+    {
+        auto below = split(std::move(root), value, false);
+        auto equal = split(std::move(below.second), value, true);
+        bool found = equal.first != nullptr;
+        if (found)
+        {
+            // Drop the root of the equal range, its children still hold the other copies
+            Node &removed = *equal.first;
+            equal.first = merge(std::move(removed.left), std::move(removed.right));
+        }
+        root = merge(merge(std::move(below.first), std::move(equal.first)), std::move(equal.second));
+        return found;
+    }
+
+    //remove every copy of 'value' by cutting out their whole subtree
+    size_t OrderStatisticTree::eraseAll(int value) noexcept
+    {
+        auto below = split(std::move(root), value, false);
+        auto equal = split(std::move(below.second), value, true);
+        size_t removed = sizeOf(equal.first);
+        root = merge(std::move(below.first), std::move(equal.second));
+        return removed;
+    }
+
+    bool OrderStatisticTree::contains(int value) const
+    {
+        const Node *node = root.get();
+        while (node != nullptr && node->value != value)
+        {
+            node = value < node->value ? node->left.get() : node->right.get();
+        }
+        return node != nullptr;
+    }
+
+    size_t OrderStatisticTree::size() const
+    {
+        return sizeOf(root);
+    }
+
+    size_t OrderStatisticTree::primeCount() const
+    {
+        return primesOf(root);
+    }
+
+    size_t OrderStatisticTree::count(int value) const
+    {
+        return countBelow(value, true) - countBelow(value, false);
+    }
+
+    size_t OrderStatisticTree::rank(int value) const
+    {
+        return countBelow(value, false);
+    }
+
+    //number of elements below 'value', or not above it when inclusive
+    size_t OrderStatisticTree::countBelow(int value, bool inclusive) const
+    {
+        size_t smaller = 0;
+        const Node *node = root.get();
+        while (node != nullptr)
+        {
+            if (node->value < value || (inclusive && node->value == value))
+            {
+                smaller += sizeOf(node->left) + 1;
+                node = node->right.get();
+            }
+            else
+            {
+                node = node->left.get();
+            }
+        }
+        return smaller;
+    }
+
+    const int &OrderStatisticTree::select(size_t rank) const
+    {
+        if (rank >= size())
+        {
+            throw std::out_of_range("Rank out of range");
+        }
+        const Node *node = root.get();
+        while (true)
+        {
+            size_t leftSize = sizeOf(node->left);
+            if (rank < leftSize)
+            {
+                node = node->left.get();
+            }
+            else if (rank == leftSize)
+            {
+                return node->value;
+            }
+            else
+            {
+                rank -= leftSize + 1;
+                node = node->right.get();
+            }
+        }
+    }
+
+    const int &OrderStatisticTree::selectPrime(size_t primeRank) const
+    {
+        if (primeRank >= primeCount())
+        {
+            throw std::out_of_range("Prime rank out of range");
+        }
+        const Node *node = root.get();
+        while (true)
+        {
+            size_t leftPrimes = primesOf(node->left);
+            if (primeRank < leftPrimes)
+            {
+                node = node->left.get();
+            }
+            else if (node->prime && primeRank == leftPrimes)
+            {
+                return node->value;
+            }
+            else
+            {
+                primeRank -= leftPrimes + (node->prime ? 1 : 0);
+                node = node->right.get();
+            }
+        }
+    }
+
+    //the hint is deliberately ignored: without parent links a neighbour costs the same descent as any rank
+    const int &OrderStatisticTree::select(size_t rank, SeekHint & /*hint*/) const
+    {
+        return select(rank);
+    }
+
+    //the hint is deliberately ignored, as in select
+    const int &OrderStatisticTree::selectPrime(size_t primeRank, SeekHint & /*hint*/) const
+    {
+        return selectPrime(primeRank);
+    }
+
+    //copy of all the elements in ascending order, in-order walk with an explicit stack
+    vector<int> OrderStatisticTree::toVector() const
+    {
+        vector<int> result;
+        result.reserve(size());
+        vector<const Node *> path;
+        const Node *node = root.get();
+        while (node != nullptr || !path.empty())
+        {
+            while (node != nullptr)
+            {
+                path.push_back(node);
+                node = node->left.get();
+            }
+            node = path.back();
+            path.pop_back();
+            result.push_back(node->value);
+            node = node->right.get();
+        }
+        return result;
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef ORDER_STATISTIC_TREE_HPP
+#define ORDER_STATISTIC_TREE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "SeekHint.hpp"
+
+namespace ariel
+{
+    using namespace std;
+
+    // Sorted multiset of integers in a treap whose nodes count the elements and the primes below them.
+    // Insert, erase, rank and select all take O(log n) expected time.
+    class OrderStatisticTree
+    {
+    private:
+        struct Node
+        {
+            int value;
+            uint32_t priority;
+            bool prime;
+            size_t size;   // Elements in this subtree
+            size_t primes; // Prime elements in this subtree
+            unique_ptr<Node> left;
+            unique_ptr<Node> right;
+
+            Node(int value, uint32_t priority, bool prime);
+        };
+
+        unique_ptr<Node> root;
+        uint32_t seed;
+
+        uint32_t nextPriority();
+        static size_t sizeOf(const unique_ptr<Node> &node);
+        static size_t primesOf(const unique_ptr<Node> &node);
+        size_t countBelow(int value, bool inclusive) const;
+        static void update(Node &node);
+        static pair<unique_ptr<Node>, unique_ptr<Node>> split(unique_ptr<Node> node, int value, bool keepEqual);
+        static unique_ptr<Node> merge(unique_ptr<Node> left, unique_ptr<Node> right);
+
+    public:
+        OrderStatisticTree();
+        void insert(int value);
+        // Erasing only splits and merges existing nodes, it never allocates
+        bool erase(int value) noexcept;
+        size_t eraseAll(int value) noexcept;
+        bool contains(int value) const;
+        size_t count(int value) const;
+        size_t size() const;
+        size_t primeCount() const;
+        // Number of elements smaller than 'value'
+        size_t rank(int value) const;
+        // The element at position 'rank' in ascending order
+        const int &select(size_t rank) const;
+        // The prime at position 'primeRank' among the primes in ascending order
+        const int &selectPrime(size_t primeRank) const;
+        // Storage engine interface of MagicalContainer. The hint is deliberately ignored and left as it was:
+        // nodes have no parent links, so a neighbour is no cheaper to reach than any other rank and every
+        // lookup descends from the root in O(log n)
+        const int &select(size_t rank, SeekHint &hint) const;
+        const int &selectPrime(size_t primeRank, SeekHint &hint) const;
+        vector<int> toVector() const;
+    };
+} // namespace ariel
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include "MagicalContainer.hpp"
+#include "Primality.hpp"
+#include "ThreadPool.hpp"
+
+namespace ariel
+{
+    namespace detail
+    {
+        // Keep halving the range, giving the first halves away and walking the last piece here
+        template <typename Spliterator, typename Fn>
+        void forEachSplit(Spliterator part, const Fn &fn, TaskGroup &group, size_t grain)
+        {
+            while (part.size() > grain)
+            {
+                Spliterator prefix = part.split();
+                group.run([prefix, &fn, &group, grain] { forEachSplit(prefix, fn, group, grain); });
+            }
+            part.forEachRemaining(fn);
+        }
+
+        // Same splitting over the index range [first, last), body gets whole chunks
+        template <typename Body>
+        void forChunks(size_t first, size_t last, const Body &body, TaskGroup &group, size_t grain)
+        {
+            while (last - first > grain)
+            {
+                size_t middle = first + (last - first) / 2;
+                group.run([first, middle, &body, &group, grain] { forChunks(first, middle, body, group, grain); });
+                first = middle;
+            }
+            body(first, last);
+        }
+
+        // Run body(first, last) over chunks covering [0, count), inline when the range is small
+        template <typename Body>
+        void parallelChunks(size_t count, const Body &body, const ParallelPolicy &policy)
+        {
+            if (policy.sequential(count))
+            {
+                body(0, count);
+                return;
+            }
+            TaskGroup group(policy.threadPool());
+            forChunks(0, count, body, group, std::max<size_t>(policy.grain, 1));
+            group.wait();
+        }
+    } // namespace detail
+
+    // Call fn on every element of one of the container's views (ascending(), sideCross(), primes())
+    // from the pool's workers. fn runs concurrently, in no particular order, and must be thread safe.
+    // The container must not change until the call returns, and like the views it must not hold
+    // buffered inserts or dead slots.
+    template <typename View, typename Fn>
+    void parallel_for_each(const View &view, Fn fn, const ParallelPolicy &policy = {})
+    {
+        auto whole = view.spliterator();
+        if (policy.sequential(whole.size()))
+        {
+            whole.forEachRemaining(fn);
+            return;
+        }
+        TaskGroup group(policy.threadPool());
+        detail::forEachSplit(whole, fn, group, std::max<size_t>(policy.grain, 1));
+        group.wait();
+    }
+
+    // The algorithms below read through elementsView(), which throws while writes are still buffered
+
+    // Sum of all the elements, in 64 bits so it cannot overflow
+    inline long long parallel_sum(const MagicalContainer &container, const ParallelPolicy &policy = {})
+    {
+        span<const int> values = container.elementsView();
+        atomic<long long> total(0);
+        detail::parallelChunks(values.size(), [&](size_t first, size_t last) {
+            long long partial = 0;
+            for (size_t i = first; i < last; ++i)
+            {
+                partial += values[i];
+            }
+            total.fetch_add(partial, memory_order_relaxed);
+        }, policy);
+        return total.load();
+    }
+
+    // Number of elements for which pred holds, pred must be thread safe
+    template <typename Pred>
+    size_t parallel_count_if(const MagicalContainer &container, Pred pred, const ParallelPolicy &policy = {})
+    {
+        span<const int> values = container.elementsView();
+        atomic<size_t> total(0);
+        detail::parallelChunks(values.size(), [&](size_t first, size_t last) {
+            size_t partial = 0;
+            for (size_t i = first; i < last; ++i)
+            {
+                partial += pred(values[i]) ? 1U : 0U;
+            }
+            total.fetch_add(partial, memory_order_relaxed);
+        }, policy);
+        return total.load();
+    }
+
+    // Write fn(element) for the elements in ascending order into out, like fill() stops when out
+    // is full and returns how many were written
+    template <typename T, typename Fn>
+    size_t parallel_transform_into(const MagicalContainer &container, span<T> out, Fn fn,
+                                   const ParallelPolicy &policy = {})
+    {
+        span<const int> values = container.elementsView();
+        values = values.first(std::min(out.size(), values.size()));
+        detail::parallelChunks(values.size(), [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i)
+            {
+                out[i] = fn(values[i]);
+            }
+        }, policy);
+        return values.size();
+    }
+
+    // flags[i] = 1 when values[i] is prime, checks every value from scratch with isPrime()
+    inline void parallel_classify_primes(span<const int> values, span<uint8_t> flags,
+                                         const ParallelPolicy &policy = {})
+    {
+        size_t count = std::min(values.size(), flags.size());
+        detail::parallelChunks(count, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i)
+            {
+                flags[i] = isPrime(values[i]) ? 1 : 0;
+            }
+        }, policy);
+    }
+
+    // flags[i] = 1 when the element at i is prime. The container already knows its primes, so this only
+    // scatters the cached prime positions and never calls isPrime()
+    inline vector<uint8_t> parallel_classify_primes(const MagicalContainer &container, const ParallelPolicy &policy = {})
+    {
+        span<const int> values = container.elementsView();
+        span<const size_t> primes = container.primePositionsView();
+        vector<uint8_t> flags(values.size(), 0);
+        detail::parallelChunks(primes.size(), [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i)
+            {
+                flags[primes[i]] = 1;
+            }
+        }, policy);
+        return flags;
+    }
+} // namespace ariel
+
+#endif
@@ -0,0 +1,220 @@
+#include "Primality.hpp"
+#include <algorithm>
+#include <iterator>
+#include <mutex>
+
+namespace ariel
+{
+    namespace
+    {
+        // Smallest sieve built on the first query
+        const std::uint32_t INITIAL_SIEVE = 1U << 16;
+
+        // Witnesses that make Miller-Rabin exact below 2^32 and below 2^64
+        const std::uint64_t WITNESSES_32[] = {2, 7, 61};
+        const std::uint64_t WITNESSES_64[] = {2, 325, 9375, 28178, 450775, 9780504, 1795265022};
+
+        std::uint64_t mulMod(std::uint64_t lhs, std::uint64_t rhs, std::uint64_t mod)
+        {
+            // The 128-bit product cannot overflow for 64-bit operands
+            return static_cast<std::uint64_t>(static_cast<unsigned __int128>(lhs) * rhs % mod);
+        }
+
+        std::uint64_t powMod(std::uint64_t base, std::uint64_t exponent, std::uint64_t mod)
+        {
+            std::uint64_t result = 1;
+            base %= mod;
+            while (exponent > 0)
+            {
+                if (exponent & 1U)
+                {
+                    result = mulMod(result, base, mod);
+                }
+                base = mulMod(base, base, mod);
+                exponent >>= 1U;
+            }
+            return result;
+        }
+
+        //true when 'witness' proves that num = odd * 2^shift + 1 is composite
+        bool provesComposite(std::uint64_t num, std::uint64_t witness, std::uint64_t odd, unsigned shift)
+        {
+            witness %= num;
+            if (witness == 0)
+            {
+                return false;
+            }
+            std::uint64_t x = powMod(witness, odd, num);
+            if (x == 1 || x == num - 1)
+            {
+                return false;
+            }
+            for (unsigned i = 1; i < shift; ++i)
+            {
+                x = mulMod(x, x, num);
+                if (x == num - 1)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+    }
+
+    PrimeSieve::PrimeSieve(std::uint32_t bound) : sieved(0), bound(bound)
+    {
+    }
+
+    PrimeSieve &PrimeSieve::shared()
+    {
+        static PrimeSieve sieve;
+        return sieve;
+    }
+
+    bool PrimeSieve::isPrime(int num)
+    {
+        if (num < 2)
+        {
+            return false;
+        }
+        if (num % 2 == 0)
+        {
+            return num == 2;
+        }
+        auto value = static_cast<std::uint32_t>(num);
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex);
+            if (value < sieved)
+            {
+                return lookup(value);
+            }
+            if (value >= bound)
+            {
+                lock.unlock();
+                return isPrimeMillerRabin(value);
+            }
+        }
+        // Grow geometrically so a rising sequence of queries re-sieves O(log bound) times
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        if (value >= sieved)
+        {
+            std::uint32_t doubled = sieved > bound / 2 ? bound : 2 * sieved;
+            growTo(std::min(bound, std::max({value + 1, doubled, INITIAL_SIEVE})));
+        }
+        return lookup(value);
+    }
+
+    //rebuild the sieve so it covers every number below 'target'
+    void PrimeSieve::growTo(std::uint32_t target)
+    {
+        std::uint32_t oddCount = target / 2;
+        std::vector<std::uint64_t> bits((oddCount + 63) / 64, 0);
+        // 1 is not a prime
+        bits[0] |= 1;
+        for (std::uint32_t i = 1; i < oddCount; ++i)
+        {
+            std::uint64_t prime = 2 * std::uint64_t{i} + 1;
+            if (prime * prime >= target)
+            {
+                break;
+            }
+            if ((bits[i / 64] >> (i % 64)) & 1U)
+            {
+                continue;
+            }
+            // Odd multiples of 'prime' starting at its square, stepping by 2*prime
+            for (std::uint64_t multiple = prime * prime; multiple < target; multiple += 2 * prime)
+            {
+                std::uint64_t index = multiple / 2;
+                bits[index / 64] |= std::uint64_t{1} << (index % 64);
+            }
+        }
+        composite.swap(bits);
+        sieved = target;
+    }
+
+    bool PrimeSieve::lookup(std::uint32_t num) const
+    {
+        std::uint32_t index = num / 2;
+        return ((composite[index / 64] >> (index % 64)) & 1U) == 0;
+    }
+
+    std::uint32_t PrimeSieve::getBound() const
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return bound;
+    }
+
+    //numbers at or above the bound are tested by Miller-Rabin instead of the sieve
+    void PrimeSieve::setBound(std::uint32_t newBound)
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        bound = newBound;
+        if (sieved > bound)
+        {
+            composite.clear();
+            sieved = 0;
+        }
+    }
+
+    std::uint32_t PrimeSieve::sievedUpTo() const
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return sieved;
+    }
+
+    bool isPrime(int num)
+    {
+        return PrimeSieve::shared().isPrime(num);
+    }
+
+    bool isPrimeByTrialDivision(int num)
+    {
+        if (num < 2)
+        {
+            return false;
+        }
+        if (num % 2 == 0)
+        {
+            return num == 2;
+        }
+        for (int i = 3; i <= num / i; i += 2)
+        {
+            if (num % i == 0)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool isPrimeMillerRabin(std::uint64_t num)
+    {
+        if (num < 2)
+        {
+            return false;
+        }
+        // Small primes settle every small or obviously composite input without exponentiation
+        for (std::uint64_t prime : {2U, 3U, 5U, 7U, 11U, 13U, 17U, 19U, 23U, 29U, 31U, 37U})
+        {
+            if (num % prime == 0)
+            {
+                return num == prime;
+            }
+        }
+        std::uint64_t odd = num - 1;
+        unsigned shift = 0;
+        while ((odd & 1U) == 0)
+        {
+            odd >>= 1U;
+            ++shift;
+        }
+        if (num <= UINT32_MAX)
+        {
+            return std::none_of(std::begin(WITNESSES_32), std::end(WITNESSES_32),
+                                [&](std::uint64_t witness) { return provesComposite(num, witness, odd, shift); });
+        }
+        return std::none_of(std::begin(WITNESSES_64), std::end(WITNESSES_64),
+                            [&](std::uint64_t witness) { return provesComposite(num, witness, odd, shift); });
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef PRIMALITY_HPP
+#define PRIMALITY_HPP
+
+#include <cstdint>
+#include <shared_mutex>
+#include <vector>
+
+namespace ariel
+{
+    // Bit-packed Sieve of Eratosthenes over the odd numbers, grown lazily up to a configurable bound.
+    // Queries at or above the bound fall back to a deterministic Miller-Rabin test.
+    // One instance can be queried from several threads at once.
+    class PrimeSieve
+    {
+    private:
+        mutable std::shared_mutex mutex;
+        std::vector<std::uint64_t> composite; // bit i is set when 2i+1 is composite
+        std::uint32_t sieved;                 // every number below this is covered
+        std::uint32_t bound;
+
+        void growTo(std::uint32_t target);
+        bool lookup(std::uint32_t num) const;
+
+    public:
+        static constexpr std::uint32_t DEFAULT_BOUND = 1U << 24;
+
+        explicit PrimeSieve(std::uint32_t bound = DEFAULT_BOUND);
+        // The sieve used by every container
+        static PrimeSieve &shared();
+
+        bool isPrime(int num);
+        std::uint32_t getBound() const;
+        void setBound(std::uint32_t newBound);
+        std::uint32_t sievedUpTo() const;
+    };
+
+    // Primality test shared by every container and storage engine
+    bool isPrime(int num);
+    // Trial division by odd numbers up to the square root
+    bool isPrimeByTrialDivision(int num);
+    // Deterministic Miller-Rabin: fixed witness sets make it exact for every 64-bit value
+    bool isPrimeMillerRabin(std::uint64_t num);
+} // namespace ariel
+
+#endif
@@ -0,0 +1,83 @@
+#include "RadixSort.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace ariel
+{
+    namespace
+    {
+        constexpr unsigned DIGIT_BITS = 11;
+        constexpr std::size_t BUCKETS = std::size_t{1} << DIGIT_BITS;
+        constexpr unsigned PASSES = 3; // 11 + 11 + 10 bits
+
+        // Flipping the sign bit makes the unsigned order of the keys match the signed order of the values
+        std::size_t digitOf(int value, unsigned pass)
+        {
+            std::uint32_t key = static_cast<std::uint32_t>(value) ^ 0x80000000U;
+            return (key >> (pass * DIGIT_BITS)) & (BUCKETS - 1);
+        }
+    }
+
+    void radixSort(std::span<int> values)
+    {
+        std::size_t count = values.size();
+        if (count < 2)
+        {
+            return;
+        }
+        // One read builds the histograms of all the passes
+        std::vector<std::size_t> histograms(PASSES * BUCKETS, 0);
+        for (int value : values)
+        {
+            for (unsigned pass = 0; pass < PASSES; ++pass)
+            {
+                ++histograms[pass * BUCKETS + digitOf(value, pass)];
+            }
+        }
+
+        std::vector<int> buffer(count);
+        std::span<int> from = values;
+        std::span<int> to(buffer);
+        for (unsigned pass = 0; pass < PASSES; ++pass)
+        {
+            std::size_t *offsets = &histograms[pass * BUCKETS];
+            if (offsets[digitOf(from[0], pass)] == count)
+            {
+                continue;
+            }
+            std::size_t offset = 0;
+            for (std::size_t bucket = 0; bucket < BUCKETS; ++bucket)
+            {
+                std::size_t bucketSize = offsets[bucket];
+                offsets[bucket] = offset;
+                offset += bucketSize;
+            }
+            for (int value : from)
+            {
+                to[offsets[digitOf(value, pass)]++] = value;
+            }
+            std::swap(from, to);
+        }
+        if (from.data() != values.data())
+        {
+            std::copy(from.begin(), from.end(), values.begin());
+        }
+    }
+
+    void sortIntegers(std::span<int> values)
+    {
+        if (std::is_sorted(values.begin(), values.end()))
+        {
+            return;
+        }
+        if (values.size() < RADIX_SORT_THRESHOLD)
+        {
+            std::sort(values.begin(), values.end());
+        }
+        else
+        {
+            radixSort(values);
+        }
+    }
+}
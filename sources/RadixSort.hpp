@@ -0,0 +1,19 @@
+#ifndef RADIX_SORT_HPP
+#define RADIX_SORT_HPP
+
+#include <cstddef>
+#include <span>
+
+namespace ariel
+{
+    // Batches with fewer elements than this are sorted with std::sort
+    constexpr std::size_t RADIX_SORT_THRESHOLD = 1U << 12;
+
+    // LSD radix sort with 11-bit digits: three counting passes over the 32-bit keys, negative values
+    // included. Passes where every value has the same digit are skipped.
+    void radixSort(std::span<int> values);
+    // Sort used by the bulk insert paths: radix sort for large unsorted batches, std::sort otherwise
+    void sortIntegers(std::span<int> values);
+} // namespace ariel
+
+#endif
@@ -0,0 +1,219 @@
+#include "RunLengthStorage.hpp"
+#include "Primality.hpp"
+#include <algorithm>
+#include <limits>
+
+namespace ariel
+{
+    RunLengthStorage::RunLengthStorage() : total(0), primeTotal(0)
+    {
+    }
+
+    //index of the first run whose value is not below 'value'
+    size_t RunLengthStorage::findRun(int value) const
+    {
+        auto it = std::lower_bound(runs.begin(), runs.end(), value,
+                                   [](const Run &run, int key) { return run.value < key; });
+        return static_cast<size_t>(it - runs.begin());
+    }
+
+    //add a copy, only a new distinct value adds a run
+    void RunLengthStorage::insert(int value)
+    {
+        size_t run = findRun(value);
+        bool prime = false;
+        if (run < runs.size() && runs[run].value == value)
+        {
+            if (runs[run].count == std::numeric_limits<uint32_t>::max())
+            {
+                throw std::overflow_error("Too many copies of one value");
+            }
+            ++runs[run].count;
+            prime = std::binary_search(primeRuns.begin(), primeRuns.end(), run);
+        }
+        else
+        {
+            runs.insert(runs.begin() + static_cast<std::ptrdiff_t>(run), Run{value, 1});
+            prime = isPrime(value);
+            // Runs after the new one moved up by one
+            auto shifted = std::lower_bound(primeRuns.begin(), primeRuns.end(), run);
+            for (auto it = shifted; it != primeRuns.end(); ++it)
+            {
+                ++*it;
+            }
+            if (prime)
+            {
+                primeRuns.insert(shifted, run);
+            }
+        }
+        ++total;
+        primeTotal += prime ? 1U : 0U;
+    }
+
+    //remove one copy of 'value', false when it is not stored
+    bool RunLengthStorage::erase(int value) noexcept
+    {
+        size_t run = findRun(value);
+        if (run >= runs.size() || runs[run].value != value)
+        {
+            return false;
+        }
+        bool prime = std::binary_search(primeRuns.begin(), primeRuns.end(), run);
+        --total;
+        primeTotal -= prime ? 1U : 0U;
+        if (--runs[run].count == 0)
+        {
+            dropRun(run, prime);
+        }
+        return true;
+    }
+
+    //remove every copy of 'value' with its whole run, returns how many there were
+    size_t RunLengthStorage::eraseAll(int value) noexcept
+    {
+        size_t run = findRun(value);
+        if (run >= runs.size() || runs[run].value != value)
+        {
+            return 0;
+        }
+        size_t removed = runs[run].count;
+        bool prime = std::binary_search(primeRuns.begin(), primeRuns.end(), run);
+        total -= removed;
+        primeTotal -= prime ? removed : 0U;
+        dropRun(run, prime);
+        return removed;
+    }
+
+    //erase an emptied run and move the later prime runs down
+    void RunLengthStorage::dropRun(size_t run, bool prime) noexcept
+    {
+        runs.erase(runs.begin() + static_cast<std::ptrdiff_t>(run));
+        auto primeRun = std::lower_bound(primeRuns.begin(), primeRuns.end(), run);
+        if (prime)
+        {
+            primeRun = primeRuns.erase(primeRun);
+        }
+        for (auto it = primeRun; it != primeRuns.end(); ++it)
+        {
+            --*it;
+        }
+    }
+
+    bool RunLengthStorage::contains(int value) const
+    {
+        return count(value) > 0;
+    }
+
+    size_t RunLengthStorage::count(int value) const
+    {
+        size_t run = findRun(value);
+        return run < runs.size() && runs[run].value == value ? runs[run].count : 0;
+    }
+
+    size_t RunLengthStorage::size() const
+    {
+        return total;
+    }
+
+    size_t RunLengthStorage::runCount() const
+    {
+        return runs.size();
+    }
+
+    size_t RunLengthStorage::primeCount() const
+    {
+        return primeTotal;
+    }
+
+    //number of elements smaller than 'value': the copies of every run before its run
+    size_t RunLengthStorage::rank(int value) const
+    {
+        size_t smaller = 0;
+        for (size_t run = 0, last = findRun(value); run < last; ++run)
+        {
+            smaller += runs[run].count;
+        }
+        return smaller;
+    }
+
+    //the element at 'rank', one copy away from the hint when it is a neighbour
+    const int &RunLengthStorage::select(size_t rank, SeekHint &hint) const
+    {
+        if (rank >= total)
+        {
+            throw std::out_of_range("Rank out of range");
+        }
+        Position position{hint.outer, hint.inner};
+        if (hint.before(rank))
+        {
+            if (++position.copy == runs[position.run].count)
+            {
+                ++position.run;
+                position.copy = 0;
+            }
+        }
+        else if (hint.after(rank))
+        {
+            if (position.copy == 0)
+            {
+                position.copy = runs[--position.run].count;
+            }
+            --position.copy;
+        }
+        else if (!hint.at(rank))
+        {
+            position = Position{0, rank};
+            while (position.copy >= runs[position.run].count)
+            {
+                position.copy -= runs[position.run++].count;
+            }
+        }
+        hint = SeekHint{rank, position.run, position.copy};
+        return runs[position.run].value;
+    }
+
+    //the prime with 'primeRank' prime copies before it, walking the prime runs only
+    const int &RunLengthStorage::selectPrime(size_t primeRank, SeekHint &hint) const
+    {
+        if (primeRank >= primeTotal)
+        {
+            throw std::out_of_range("Prime rank out of range");
+        }
+        Position position{hint.outer, hint.inner};
+        if (hint.before(primeRank))
+        {
+            if (++position.copy == runs[primeRuns[position.run]].count)
+            {
+                ++position.run;
+                position.copy = 0;
+            }
+        }
+        else if (!hint.at(primeRank))
+        {
+            position = Position{0, primeRank};
+            while (position.copy >= runs[primeRuns[position.run]].count)
+            {
+                position.copy -= runs[primeRuns[position.run++]].count;
+            }
+        }
+        hint = SeekHint{primeRank, position.run, position.copy};
+        return runs[primeRuns[position.run]].value;
+    }
+
+    size_t RunLengthStorage::memoryBytes() const
+    {
+        return runs.capacity() * sizeof(Run) + primeRuns.capacity() * sizeof(size_t);
+    }
+
+    //expanded copy of all the elements in ascending order
+    vector<int> RunLengthStorage::toVector() const
+    {
+        vector<int> result;
+        result.reserve(total);
+        for (const Run &run : runs)
+        {
+            result.insert(result.end(), run.count, run.value);
+        }
+        return result;
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef RUN_LENGTH_STORAGE_HPP
+#define RUN_LENGTH_STORAGE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+#include "SeekHint.hpp"
+
+namespace ariel
+{
+    using namespace std;
+
+    // Sorted multiset of integers stored as (value, count) runs, one per distinct value.
+    // Adding or removing a copy of a stored value only changes its counter, the memory used grows
+    // with the number of distinct values instead of the number of elements.
+    class RunLengthStorage
+    {
+    private:
+        struct Run
+        {
+            int value;
+            uint32_t count;
+        };
+
+        vector<Run> runs;           // Ascending by value, every count above zero
+        vector<size_t> primeRuns;   // Indices of the runs whose value is prime, ascending
+        size_t total;
+        size_t primeTotal;          // Copies of prime values
+
+        // A copy inside the runs: the run and how many copies of it come before this one
+        struct Position
+        {
+            size_t run;
+            size_t copy;
+        };
+
+        size_t findRun(int value) const;
+        void dropRun(size_t run, bool prime) noexcept;
+
+    public:
+        RunLengthStorage();
+        void insert(int value);
+        // Removing copies never allocates: a counter drops, or a run and its prime index entry are erased
+        bool erase(int value) noexcept;
+        size_t eraseAll(int value) noexcept;
+        bool contains(int value) const;
+        // Copies of 'value' in the storage
+        size_t count(int value) const;
+        size_t size() const;
+        size_t runCount() const;
+        size_t primeCount() const;
+        // Order statistics: a neighbour of the hinted rank is one copy away, any other rank sums the run
+        // counts, O(runs). The hint is a run (an index into primeRuns for primes) and a copy inside it
+        size_t rank(int value) const;
+        const int &select(size_t rank, SeekHint &hint) const;
+        const int &selectPrime(size_t primeRank, SeekHint &hint) const;
+        // Bytes held by the run arrays
+        size_t memoryBytes() const;
+        vector<int> toVector() const;
+    };
+} // namespace ariel
+
+#endif
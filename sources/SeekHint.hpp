@@ -0,0 +1,28 @@
+#ifndef SEEK_HINT_HPP
+#define SEEK_HINT_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ariel
+{
+    // Where a storage engine last found an element by rank. Handing the hint back to the next lookup
+    // turns a neighbouring rank into a single step instead of a fresh search, so iterators that walk
+    // an engine rank by rank pay O(1) amortized per element.
+    // 'outer' and 'inner' are engine-defined: block and offset, or run and copy. A hint is only valid
+    // until the engine is mutated, the owner resets it to SeekHint{} after that
+    struct SeekHint
+    {
+        static constexpr size_t NONE = SIZE_MAX;
+
+        size_t rank = NONE;
+        size_t outer = 0;
+        size_t inner = 0;
+
+        bool at(size_t wanted) const { return rank != NONE && rank == wanted; }
+        bool before(size_t wanted) const { return rank != NONE && rank + 1 == wanted; }
+        bool after(size_t wanted) const { return rank != NONE && wanted + 1 == rank; }
+    };
+} // namespace ariel
+
+#endif
@@ -0,0 +1,183 @@
+#include "ThreadPool.hpp"
+#include <algorithm>
+
+namespace ariel
+{
+    namespace
+    {
+        // Queue owned by the current thread, or NO_QUEUE outside the pool's workers
+        constexpr size_t NO_QUEUE = static_cast<size_t>(-1);
+        thread_local const ThreadPool *ownerPool = nullptr;
+        thread_local size_t ownQueue = NO_QUEUE;
+    }
+
+    ThreadPool::ThreadPool(size_t workerCount) : queued(0), stopping(false)
+    {
+        workerCount = std::max<size_t>(workerCount, 1);
+        for (size_t i = 0; i < workerCount; ++i)
+        {
+            queues.push_back(std::make_unique<WorkStealingDeque<Task *>>());
+        }
+        for (size_t i = 0; i < workerCount; ++i)
+        {
+            workers.emplace_back(&ThreadPool::workerLoop, this, i);
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> guard(sleepLock);
+            stopping = true;
+        }
+        wake.notify_all();
+        // Workers only stop once every queued task has run, so the deques are empty afterwards
+        for (thread &worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    ThreadPool &ThreadPool::shared()
+    {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    size_t ThreadPool::size() const
+    {
+        return workers.size();
+    }
+
+    void ThreadPool::submit(Task task)
+    {
+        auto *owned = new Task(std::move(task));
+        if (ownerPool == this)
+        {
+            queues[ownQueue]->push(owned);
+        }
+        else
+        {
+            std::lock_guard<std::mutex> guard(injectedLock);
+            injected.push_back(owned);
+        }
+        queued.fetch_add(1);
+        // Taking the sleep lock orders the increment before any worker's wait predicate
+        {
+            std::lock_guard<std::mutex> guard(sleepLock);
+        }
+        wake.notify_one();
+    }
+
+    bool ThreadPool::takeInjected(Task *&task)
+    {
+        std::lock_guard<std::mutex> guard(injectedLock);
+        if (injected.empty())
+        {
+            return false;
+        }
+        task = injected.front();
+        injected.pop_front();
+        return true;
+    }
+
+    bool ThreadPool::steal(size_t thief, Task *&task)
+    {
+        for (size_t offset = 1; offset <= queues.size(); ++offset)
+        {
+            if (queues[(thief + offset) % queues.size()]->steal(task))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool ThreadPool::runOne()
+    {
+        bool isWorker = ownerPool == this;
+        size_t index = isWorker ? ownQueue : 0;
+        Task *task = nullptr;
+        if ((isWorker && queues[index]->pop(task)) || takeInjected(task) || steal(index, task))
+        {
+            queued.fetch_sub(1);
+            std::unique_ptr<Task> owned(task);
+            (*owned)();
+            return true;
+        }
+        return false;
+    }
+
+    void ThreadPool::workerLoop(size_t index)
+    {
+        ownerPool = this;
+        ownQueue = index;
+        while (true)
+        {
+            if (runOne())
+            {
+                continue;
+            }
+            std::unique_lock<std::mutex> guard(sleepLock);
+            wake.wait(guard, [this] { return stopping || queued.load() > 0; });
+            if (stopping && queued.load() == 0)
+            {
+                return;
+            }
+        }
+    }
+
+    // TaskGroup
+    TaskGroup::TaskGroup(ThreadPool &pool) : pool(pool), pending(0)
+    {
+    }
+
+    TaskGroup::~TaskGroup()
+    {
+        // Tasks reference the group, so it must outlive them even when wait() was skipped
+        while (pending.load() > 0)
+        {
+            if (!pool.runOne())
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void TaskGroup::run(ThreadPool::Task task)
+    {
+        pending.fetch_add(1);
+        pool.submit([this, task = std::move(task)] {
+            try
+            {
+                task();
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> guard(errorLock);
+                if (!error)
+                {
+                    error = std::current_exception();
+                }
+            }
+            pending.fetch_sub(1);
+        });
+    }
+
+    void TaskGroup::wait()
+    {
+        while (pending.load() > 0)
+        {
+            if (!pool.runOne())
+            {
+                std::this_thread::yield();
+            }
+        }
+        if (error)
+        {
+            std::exception_ptr thrown = error;
+            error = nullptr;
+            std::rethrow_exception(thrown);
+        }
+    }
+}
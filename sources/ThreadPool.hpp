@@ -0,0 +1,97 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "WorkStealingDeque.hpp"
+
+namespace ariel
+{
+    using namespace std;
+
+    // Small work-stealing thread pool.
+    // Every worker owns a Chase–Lev deque: it pushes and pops its own tasks at the bottom (newest first)
+    // and idle workers steal from the top of the others (oldest, usually the largest pieces of work).
+    // Tasks submitted from outside the pool go through a shared injection queue.
+    // Tasks must not throw, run them through a TaskGroup to get exceptions back.
+    class ThreadPool
+    {
+    public:
+        using Task = function<void()>;
+
+    private:
+        vector<unique_ptr<WorkStealingDeque<Task *>>> queues;
+        mutex injectedLock;
+        deque<Task *> injected;
+        vector<thread> workers;
+        atomic<size_t> queued;
+        atomic<bool> stopping;
+        mutex sleepLock;
+        condition_variable wake;
+
+        void workerLoop(size_t index);
+        bool takeInjected(Task *&task);
+        bool steal(size_t thief, Task *&task);
+
+    public:
+        explicit ThreadPool(size_t workerCount = thread::hardware_concurrency());
+        ~ThreadPool();
+        ThreadPool(const ThreadPool &other) = delete;
+        ThreadPool &operator=(const ThreadPool &other) = delete;
+
+        // The pool used by the parallel algorithms when none is given
+        static ThreadPool &shared();
+
+        size_t size() const;
+        void submit(Task task);
+        // Run one queued task on the calling thread, false when there was nothing to run
+        bool runOne();
+    };
+
+    // Fork-join scope: tasks started with run() are finished when wait() returns.
+    // The waiting thread executes queued tasks instead of blocking, so nested groups cannot deadlock.
+    class TaskGroup
+    {
+    private:
+        ThreadPool &pool;
+        atomic<size_t> pending;
+        mutex errorLock;
+        exception_ptr error;
+
+    public:
+        explicit TaskGroup(ThreadPool &pool);
+        ~TaskGroup();
+        TaskGroup(const TaskGroup &other) = delete;
+        TaskGroup &operator=(const TaskGroup &other) = delete;
+
+        void run(ThreadPool::Task task);
+        // Wait for every task, rethrows the first exception a task threw
+        void wait();
+    };
+
+    // Ranges at or below this many elements are not split any further
+    constexpr size_t DEFAULT_GRAIN = 2048;
+    // Below this many elements the algorithms run on the calling thread only
+    constexpr size_t DEFAULT_SEQUENTIAL_THRESHOLD = 32768;
+
+    // Where and how finely the parallel algorithms run
+    struct ParallelPolicy
+    {
+        ThreadPool *pool = nullptr; // nullptr: ThreadPool::shared(), one worker per hardware thread
+        size_t sequentialThreshold = DEFAULT_SEQUENTIAL_THRESHOLD;
+        size_t grain = DEFAULT_GRAIN;
+
+        ThreadPool &threadPool() const { return pool != nullptr ? *pool : ThreadPool::shared(); }
+        bool sequential(size_t count) const { return count < sequentialThreshold; }
+    };
+} // namespace ariel
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef WORK_STEALING_DEQUE_HPP
+#define WORK_STEALING_DEQUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace ariel
+{
+    using namespace std;
+
+    // Lock-free Chase–Lev deque (Lê, Pop, Cohen, Zappa Nardelli, PPoPP 2013).
+    // Only the owning thread calls push() and pop(), at the bottom; any thread may steal() from the top.
+    // The ring doubles when full and the old rings stay alive until the deque is destroyed, because a
+    // thief may still be reading one.
+    template <typename T>
+    class WorkStealingDeque
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "Deque slots are atomics");
+
+    private:
+        struct Ring
+        {
+            size_t mask;
+            unique_ptr<atomic<T>[]> slots;
+
+            explicit Ring(size_t capacity) : mask(capacity - 1), slots(std::make_unique<atomic<T>[]>(capacity)) {}
+
+            size_t capacity() const { return mask + 1; }
+            T load(int64_t index) const { return slots[static_cast<size_t>(index) & mask].load(memory_order_relaxed); }
+            void store(int64_t index, T value) { slots[static_cast<size_t>(index) & mask].store(value, memory_order_relaxed); }
+        };
+
+        atomic<int64_t> top;
+        atomic<int64_t> bottom;
+        atomic<Ring *> ring;
+        // Every ring ever allocated, only the owner touches this
+        vector<unique_ptr<Ring>> rings;
+
+        Ring *grow(Ring *old, int64_t first, int64_t last)
+        {
+            rings.push_back(std::make_unique<Ring>(old->capacity() * 2));
+            Ring *bigger = rings.back().get();
+            for (int64_t i = first; i < last; ++i)
+            {
+                bigger->store(i, old->load(i));
+            }
+            ring.store(bigger, memory_order_release);
+            return bigger;
+        }
+
+    public:
+        // capacity must be a power of two
+        explicit WorkStealingDeque(size_t capacity = 64) : top(0), bottom(0)
+        {
+            rings.push_back(std::make_unique<Ring>(capacity));
+            ring.store(rings.back().get(), memory_order_relaxed);
+        }
+
+        WorkStealingDeque(const WorkStealingDeque &other) = delete;
+        WorkStealingDeque &operator=(const WorkStealingDeque &other) = delete;
+
+        // Owner only
+        void push(T value)
+        {
+            int64_t last = bottom.load(memory_order_relaxed);
+            int64_t first = top.load(memory_order_acquire);
+            Ring *current = ring.load(memory_order_relaxed);
+            if (last - first >= static_cast<int64_t>(current->capacity()))
+            {
+                current = grow(current, first, last);
+            }
+            current->store(last, value);
+            atomic_thread_fence(memory_order_release);
+            bottom.store(last + 1, memory_order_relaxed);
+        }
+
+        // Owner only: take the newest value, false when empty
+        bool pop(T &value)
+        {
+            int64_t last = bottom.load(memory_order_relaxed) - 1;
+            Ring *current = ring.load(memory_order_relaxed);
+            bottom.store(last, memory_order_relaxed);
+            atomic_thread_fence(memory_order_seq_cst);
+            int64_t first = top.load(memory_order_relaxed);
+            if (first > last)
+            {
+                bottom.store(last + 1, memory_order_relaxed);
+                return false;
+            }
+            value = current->load(last);
+            if (first == last)
+            {
+                // Last value: race the thieves for it
+                bool won = top.compare_exchange_strong(first, first + 1, memory_order_seq_cst, memory_order_relaxed);
+                bottom.store(last + 1, memory_order_relaxed);
+                return won;
+            }
+            return true;
+        }
+
+        // Any thread: take the oldest value, false when empty or when another thread got it first
+        bool steal(T &value)
+        {
+            int64_t first = top.load(memory_order_acquire);
+            atomic_thread_fence(memory_order_seq_cst);
+            int64_t last = bottom.load(memory_order_acquire);
+            if (first >= last)
+            {
+                return false;
+            }
+            Ring *current = ring.load(memory_order_acquire);
+            value = current->load(first);
+            return top.compare_exchange_strong(first, first + 1, memory_order_seq_cst, memory_order_relaxed);
+        }
+
+        bool empty() const
+        {
+            return top.load(memory_order_acquire) >= bottom.load(memory_order_acquire);
+        }
+    };
+} // namespace ariel
+
+#endif